@@ -0,0 +1,220 @@
+/*
+ * DatasetManifest.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "DatasetManifest.h"
+
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QDebug>
+
+/* "ILMF" - Image Labeler ManiFest */
+static const quint32 manifestMagic = 0x494c4d46;
+/* version 2 keeps the hashes for finding duplicates,
+ * version 3 keeps the keys of the labeling data instead of their hashes */
+static const quint32 manifestVersion = 3;
+
+//! A constructor of the empty manifest
+DatasetManifest::DatasetManifest()
+{
+
+}
+
+//! Reads the manifest of the dataset
+/*!
+ * \param[in] aRoot a path to the dataset root
+ *
+ * Returns false if there is no manifest or it can not be read, the
+ * manifest stays empty then but keeps the root.
+ */
+bool
+DatasetManifest::load(const QString &aRoot)
+{
+	clear();
+	setRoot(aRoot);
+
+	QFile file(QDir(root_).absoluteFilePath(fileName()));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	stream >> magic >> version;
+	if (manifestMagic != magic || version < 1 || manifestVersion < version) {
+		qDebug() << "DatasetManifest::load: unknown format of " <<
+			file.fileName();
+		return false;
+		/* NOTREACHED */
+	}
+
+	quint32 dirCount = 0;
+	stream >> dirCount;
+	directories_.reserve(dirCount);
+
+	for (quint32 i = 0; i < dirCount && QDataStream::Ok == stream.status(); i++) {
+		QString path;
+		ManifestDirectory directory;
+		quint32 imageCount = 0;
+		stream >> path >> directory.modified_ >> directory.subdirs_ >>
+			imageCount;
+
+		/* directories with the old annotations are listed again */
+		if (version < 3)
+			directory.modified_ = 0;
+
+		QString absolutePath =
+			QDir::cleanPath(QDir(root_).absoluteFilePath(path));
+		for (quint32 j = 0; j < imageCount; j++) {
+			Image image;
+			QString name;
+			stream >> name >> image.labeled_ >> image.size_ >>
+				image.bytes_ >> image.modified_ >> image.annotation_;
+			if (2 <= version)
+				stream >> image.content_hash_ >> image.perceptual_hash_;
+			image.image_ = absolutePath + QString("/") + name;
+			directory.images_.append(image);
+		}
+
+		directories_.insert(path, directory);
+	}
+
+	if (QDataStream::Ok != stream.status()) {
+		qDebug() << "DatasetManifest::load: " << file.fileName() <<
+			" is corrupted";
+		clear();
+		setRoot(aRoot);
+		return false;
+		/* NOTREACHED */
+	}
+
+	return true;
+}
+
+//! Writes the manifest to the dataset root
+/*!
+ * The file is rewritten in place: creating a new file would change the
+ * modification time of the root and it would be listed on every scan.
+ * A manifest which was not written completely is rejected by load().
+ */
+bool
+DatasetManifest::save() const
+{
+	QFile file(QDir(root_).absoluteFilePath(fileName()));
+	if (root_.isEmpty() || !file.open(QIODevice::WriteOnly)) {
+		qDebug() << "DatasetManifest::save: can not write to " << root_;
+		return false;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << manifestMagic << manifestVersion <<
+		quint32(directories_.count());
+
+	QHash< QString, ManifestDirectory >::const_iterator i;
+	for (i = directories_.constBegin(); i != directories_.constEnd(); ++i) {
+		const ManifestDirectory &directory = i.value();
+		stream << i.key() << directory.modified_ << directory.subdirs_ <<
+			quint32(directory.images_.count());
+
+		foreach (const Image &image, directory.images_) {
+			int slash = image.image_.lastIndexOf('/');
+			stream << image.image_.mid(slash + 1) << image.labeled_ <<
+				image.size_ << image.bytes_ << image.modified_ <<
+				image.annotation_ << image.content_hash_ <<
+				image.perceptual_hash_;
+		}
+	}
+
+	if (QDataStream::Ok != stream.status()) {
+		qDebug() << "DatasetManifest::save: can not write " <<
+			file.fileName();
+		file.remove();
+		return false;
+		/* NOTREACHED */
+	}
+
+	return true;
+}
+
+//! Removes all the directories
+void
+DatasetManifest::clear()
+{
+	directories_.clear();
+}
+
+//! Sets the path to the dataset root
+void
+DatasetManifest::setRoot(const QString &aRoot)
+{
+	root_ = QDir(aRoot).absolutePath();
+}
+
+//! Returns the absolute path to the dataset root
+QString
+DatasetManifest::root() const
+{
+	return root_;
+}
+
+//! Returns true if the manifest knows aDir
+/*!
+ * \param[in] aDir an absolute path to the directory inside the root
+ */
+bool
+DatasetManifest::contains(const QString &aDir) const
+{
+	return directories_.contains(relativePath(aDir));
+}
+
+//! Returns what the scanner found in aDir last time
+/*!
+ * \param[in] aDir an absolute path to the directory inside the root
+ */
+ManifestDirectory
+DatasetManifest::directory(const QString &aDir) const
+{
+	return directories_.value(relativePath(aDir));
+}
+
+//! Stores what the scanner found in aDir
+/*!
+ * \param[in] aDir an absolute path to the directory inside the root
+ * \param[in] aDirectory images and subdirectories of aDir
+ */
+void
+DatasetManifest::setDirectory(
+	const QString &aDir,
+	const ManifestDirectory &aDirectory
+)
+{
+	directories_.insert(relativePath(aDir), aDirectory);
+}
+
+//! Returns the name of the manifest file in the dataset root
+QString
+DatasetManifest::fileName()
+{
+	return QString(".ImageLabeler.manifest");
+}
+
+//! Returns the path of aDir relative to the root_
+QString
+DatasetManifest::relativePath(const QString &aDir) const
+{
+	return QDir(root_).relativeFilePath(aDir);
+}
+
+/*
+ *
+ */
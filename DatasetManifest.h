@@ -0,0 +1,78 @@
+/*!
+ * \file DatasetManifest.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __DATASETMANIFEST_H__
+#define __DATASETMANIFEST_H__
+
+#include "ImageScanner.h"
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+
+//! Structure keeps everything the scanner found in one directory
+/*
+ * modified_ is the modification time of the directory, if it has not
+ * changed since the last scan the directory does not need to be listed
+ * again.
+ */
+struct ManifestDirectory {
+	ManifestDirectory() : modified_(0) {}
+
+	uint modified_;
+	QStringList subdirs_;
+	QList< Image > images_;
+};
+
+//! \brief Results of the previous scan kept in a file at the dataset root.
+/*!
+ * Paths in the file are relative to the root, so the dataset can be moved
+ * or mounted somewhere else without losing the manifest.
+ *
+ * Files rewritten in place do not change the modification time of their
+ * directory, so the scanner takes the keys of the labeling data files of
+ * the directories it does not list again once more. Sizes and modification
+ * times of the images(and so their hashes) are taken from the manifest till
+ * something is added to or removed from the directory.
+ *
+ * \see ImageScanner::run()
+ */
+class DatasetManifest
+{
+public:
+	DatasetManifest();
+
+	bool load(const QString &aRoot);
+	bool save() const;
+	void clear();
+	void setRoot(const QString &aRoot);
+	QString root() const;
+	bool contains(const QString &aDir) const;
+	ManifestDirectory directory(const QString &aDir) const;
+	void setDirectory(
+		const QString &aDir,
+		const ManifestDirectory &aDirectory
+		);
+
+	static QString fileName();
+
+private:
+	QString relativePath(const QString &aDir) const;
+
+	//! absolute path to the dataset root
+	QString root_;
+
+	//! directories keyed by path relative to the root_
+	QHash< QString, ManifestDirectory > directories_;
+};
+
+#endif /* __DATASETMANIFEST_H__ */
+
+/*
+ *
+ */
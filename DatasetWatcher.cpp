@@ -0,0 +1,214 @@
+/*
+ * DatasetWatcher.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "DatasetWatcher.h"
+
+#include <QtConcurrentRun>
+#include <QFileSystemWatcher>
+#include <QTimer>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+
+//! Lists the images and subdirectories of aDir(runs in a worker thread)
+static ManifestDirectory
+readDirectory(const QString &aDir)
+{
+	ManifestDirectory directory;
+	QDir dir(aDir);
+	if (!dir.exists()) {
+		return directory;
+		/* NOTREACHED */
+	}
+
+	directory.modified_ = QFileInfo(aDir).lastModified().toTime_t();
+	ImageScanner::scanDirectory(dir, &directory.images_);
+	directory.subdirs_ =
+		dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+
+	return directory;
+}
+
+//! A constructor initializing some variables
+DatasetWatcher::DatasetWatcher(QObject *aParent)
+	: QObject(aParent)
+{
+	enabled_ = 0;
+
+	watcher_ = new QFileSystemWatcher(this);
+	timer_ = new QTimer(this);
+	timer_->setSingleShot(true);
+	timer_->setInterval(1000);
+
+	connect(
+		watcher_,
+		SIGNAL(directoryChanged(const QString &)),
+		this,
+		SLOT(onDirectoryChanged(const QString &))
+		);
+	connect(
+		timer_,
+		SIGNAL(timeout()),
+		this,
+		SLOT(onTimeout())
+		);
+}
+
+//! A destructor waiting for the directories being listed
+DatasetWatcher::~DatasetWatcher()
+{
+	foreach (QFutureWatcher< ManifestDirectory > *lister, listing_)
+		lister->waitForFinished();
+}
+
+//! Starts or stops watching all the directories of the dataset
+void
+DatasetWatcher::setEnabled(bool anEnabled)
+{
+	if (anEnabled == enabled_) {
+		return;
+		/* NOTREACHED */
+	}
+
+	enabled_ = anEnabled;
+
+	if (!watcher_->directories().isEmpty())
+		watcher_->removePaths(watcher_->directories());
+	if (enabled_ && !directories_.isEmpty())
+		watcher_->addPaths(directories_.toList());
+
+	changed_.clear();
+}
+
+//! Returns true if the directories are being watched
+bool
+DatasetWatcher::isEnabled() const
+{
+	return enabled_;
+}
+
+//! Adds directories of the dataset found by the scanner
+void
+DatasetWatcher::addDirectories(const QStringList &aDirs)
+{
+	QStringList newDirs;
+	foreach (QString dir, aDirs) {
+		if (!directories_.contains(dir)) {
+			directories_.insert(dir);
+			newDirs.append(dir);
+		}
+	}
+
+	if (enabled_ && !newDirs.isEmpty())
+		watcher_->addPaths(newDirs);
+}
+
+//! Forgets all the directories
+void
+DatasetWatcher::clear()
+{
+	if (!watcher_->directories().isEmpty())
+		watcher_->removePaths(watcher_->directories());
+
+	directories_.clear();
+	changed_.clear();
+	timer_->stop();
+
+	/* results of the running listings are not needed anymore */
+	foreach (QFutureWatcher< ManifestDirectory > *lister, listing_)
+		lister->deleteLater();
+	listing_.clear();
+}
+
+//! A slot member collecting the changed directories
+void
+DatasetWatcher::onDirectoryChanged(const QString &aDir)
+{
+	changed_.insert(aDir);
+
+	if (!timer_->isActive())
+		timer_->start();
+}
+
+//! A slot member listing all the directories changed during the last burst
+void
+DatasetWatcher::onTimeout()
+{
+	foreach (QString dir, changed_)
+		listDirectory(dir);
+
+	changed_.clear();
+}
+
+//! Starts listing aDir in a worker thread
+void
+DatasetWatcher::listDirectory(const QString &aDir)
+{
+	/* it will be listed once again after the current listing */
+	if (listing_.contains(aDir)) {
+		changed_.insert(aDir);
+		timer_->start();
+		return;
+		/* NOTREACHED */
+	}
+
+	QFutureWatcher< ManifestDirectory > *lister =
+		new QFutureWatcher< ManifestDirectory >(this);
+	lister->setProperty("path", aDir);
+	connect(
+		lister,
+		SIGNAL(finished()),
+		this,
+		SLOT(onDirectoryListed())
+		);
+	listing_.insert(aDir, lister);
+
+	lister->setFuture(QtConcurrent::run(readDirectory, aDir));
+}
+
+//! \brief A slot member being called when the worker thread
+//! finished listing the directory
+void
+DatasetWatcher::onDirectoryListed()
+{
+	QFutureWatcher< ManifestDirectory > *lister =
+		static_cast< QFutureWatcher< ManifestDirectory > * >(sender());
+	if (!lister) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QString dir = lister->property("path").toString();
+	ManifestDirectory directory = lister->result();
+	listing_.remove(dir);
+	lister->deleteLater();
+
+	/* removed directory */
+	if (!directory.modified_) {
+		directories_.remove(dir);
+		if (enabled_)
+			watcher_->removePath(dir);
+	}
+
+	/* new subdirectories are watched and listed too */
+	QStringList newDirs;
+	foreach (QString subdir, directory.subdirs_) {
+		QString path = dir + QString("/") + subdir;
+		if (!directories_.contains(path)) {
+			newDirs.append(path);
+			listDirectory(path);
+		}
+	}
+	addDirectories(newDirs);
+
+	emit directoryUpdated(dir, directory.images_);
+}
+
+/*
+ *
+ */
@@ -0,0 +1,90 @@
+/*!
+ * \file DatasetWatcher.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __DATASETWATCHER_H__
+#define __DATASETWATCHER_H__
+
+#include "DatasetManifest.h"
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+#include <QFutureWatcher>
+
+/* forward declarations */
+class QFileSystemWatcher;
+class QTimer;
+
+//! \brief Watches the directories of the loaded dataset for new, removed
+//! and labeled images.
+/*!
+ * Changes come from the file system in bursts(copying a thousand images
+ * means a thousand notifications), so changed directories are collected
+ * for a while and each of them is listed only once in a worker thread.
+ * New subdirectories are watched and listed as well.
+ *
+ * Watching is optional(see setEnabled(bool anEnabled)) since every watched
+ * directory takes a system resource(inotify watch on linux for instance).
+ * Files are not watched: a data file rewritten in place is not noticed,
+ * that is why ImageLabeler::saveAllInfo() replaces it by a new one.
+ *
+ * \see ImageLabeler::onDirectoryUpdated()
+ */
+class DatasetWatcher : public QObject
+{
+	Q_OBJECT
+public:
+	DatasetWatcher(QObject *aParent = 0);
+	virtual ~DatasetWatcher();
+
+	bool isEnabled() const;
+	void addDirectories(const QStringList &aDirs);
+	void clear();
+
+public slots:
+	void setEnabled(bool anEnabled);
+
+signals:
+	//! \brief emitted when the directory has changed, anImages are all
+	//! the images it contains now(empty if it was removed)
+	void directoryUpdated(const QString &aDir, const QList< Image > &anImages);
+
+private slots:
+	void onDirectoryChanged(const QString &aDir);
+	void onTimeout();
+	void onDirectoryListed();
+
+private:
+	void listDirectory(const QString &aDir);
+
+	//! notifies about changes of the watched directories
+	QFileSystemWatcher *watcher_;
+
+	//! \brief collects the changes for a while
+	//! \see onDirectoryChanged(const QString &aDir)
+	QTimer *timer_;
+
+	//! all the directories of the dataset
+	QSet< QString > directories_;
+
+	//! directories changed since the last timeout
+	QSet< QString > changed_;
+
+	//! directories being listed at the moment
+	QHash< QString, QFutureWatcher< ManifestDirectory > * > listing_;
+
+	//! whether the directories are watched or not
+	bool enabled_;
+};
+
+#endif /* __DATASETWATCHER_H__ */
+
+/*
+ *
+ */
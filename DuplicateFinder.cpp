@@ -0,0 +1,369 @@
+/*
+ * DuplicateFinder.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "DuplicateFinder.h"
+#include "ImageArchive.h"
+
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QHash>
+#include <QtEndian>
+#include <QtAlgorithms>
+#include <QDebug>
+
+/* XXH64 primes */
+static const quint64 prime1 = Q_UINT64_C(0x9E3779B185EBCA87);
+static const quint64 prime2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+static const quint64 prime3 = Q_UINT64_C(0x165667B19E3779F9);
+static const quint64 prime4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+static const quint64 prime5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+/* 16 megapixels, 64 MB decoded; hashing runs on several threads at once */
+static const qint64 maxDecodedPixels = 4096 * 4096;
+
+static inline quint64
+rotateLeft(quint64 aValue, int aBits)
+{
+	return (aValue << aBits) | (aValue >> (64 - aBits));
+}
+
+static inline quint64
+hashRound(quint64 anAccumulator, quint64 anInput)
+{
+	anAccumulator += anInput * prime2;
+	anAccumulator = rotateLeft(anAccumulator, 31);
+	return anAccumulator * prime1;
+}
+
+static inline quint64
+mergeRound(quint64 anAccumulator, quint64 aValue)
+{
+	anAccumulator ^= hashRound(0, aValue);
+	return anAccumulator * prime1 + prime4;
+}
+
+//! Returns a root of the set anItem belongs to(disjoint set forest)
+static int
+findSet(QVector< int > &aParents, int anItem)
+{
+	while (aParents.at(anItem) != anItem) {
+		aParents[anItem] = aParents.at(aParents.at(anItem));
+		anItem = aParents.at(anItem);
+	}
+
+	return anItem;
+}
+
+//! Joins the sets of aFirst and aSecond, the smaller root becomes the root
+static void
+joinSets(QVector< int > &aParents, int aFirst, int aSecond)
+{
+	int first = findSet(aParents, aFirst);
+	int second = findSet(aParents, aSecond);
+	if (first < second)
+		aParents[second] = first;
+	else
+		aParents[first] = second;
+}
+
+//! Returns the XXH64 hash of aData
+/*!
+ * A fast non-cryptographic hash, reading the file is much slower
+ * than hashing it.
+ */
+quint64
+DuplicateFinder::hash(const uchar *aData, qint64 aSize, quint64 aSeed)
+{
+	const uchar *p = aData;
+	const uchar *end = aData + aSize;
+	quint64 result = 0;
+
+	if (32 <= aSize) {
+		const uchar *limit = end - 32;
+		quint64 v1 = aSeed + prime1 + prime2;
+		quint64 v2 = aSeed + prime2;
+		quint64 v3 = aSeed;
+		quint64 v4 = aSeed - prime1;
+
+		do {
+			v1 = hashRound(v1, qFromLittleEndian< quint64 >(p));
+			v2 = hashRound(v2, qFromLittleEndian< quint64 >(p + 8));
+			v3 = hashRound(v3, qFromLittleEndian< quint64 >(p + 16));
+			v4 = hashRound(v4, qFromLittleEndian< quint64 >(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		result = rotateLeft(v1, 1) + rotateLeft(v2, 7) +
+			rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		result = mergeRound(result, v1);
+		result = mergeRound(result, v2);
+		result = mergeRound(result, v3);
+		result = mergeRound(result, v4);
+	}
+	else {
+		result = aSeed + prime5;
+	}
+
+	result += quint64(aSize);
+
+	while (p + 8 <= end) {
+		result ^= hashRound(0, qFromLittleEndian< quint64 >(p));
+		result = rotateLeft(result, 27) * prime1 + prime4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		result ^= quint64(qFromLittleEndian< quint32 >(p)) * prime1;
+		result = rotateLeft(result, 23) * prime2 + prime3;
+		p += 4;
+	}
+
+	while (p < end) {
+		result ^= quint64(*p) * prime5;
+		result = rotateLeft(result, 11) * prime1;
+		p++;
+	}
+
+	result ^= result >> 33;
+	result *= prime2;
+	result ^= result >> 29;
+	result *= prime3;
+	result ^= result >> 32;
+
+	return result;
+}
+
+//! Returns the hash of the file contents, 0 if it can not be read
+/*!
+ * The file is memory mapped, so it is not copied into memory.
+ * It is safe to call this function from any thread.
+ */
+quint64
+DuplicateFinder::contentHash(const QString &aPath)
+{
+	/* members of archives are mapped already */
+	if (ImageArchive::isMemberPath(aPath)) {
+		QByteArray member = ImageArchive::memberData(aPath);
+		if (member.isNull()) {
+			return 0;
+			/* NOTREACHED */
+		}
+
+		quint64 result = hash(
+			reinterpret_cast< const uchar * >(member.constData()),
+			member.size()
+			);
+		return result ? result : 1;
+		/* NOTREACHED */
+	}
+
+	QFile file(aPath);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	quint64 result = 0;
+	uchar *data = file.size() ? file.map(0, file.size()) : 0;
+	if (data) {
+		result = hash(data, file.size());
+		file.unmap(data);
+	}
+	else {
+		QByteArray bytes = file.readAll();
+		result = hash(
+			reinterpret_cast< const uchar * >(bytes.constData()),
+			bytes.size()
+			);
+	}
+
+	/* 0 means "not computed" */
+	return result ? result : 1;
+}
+
+//! Returns the difference hash of the image, 0 if it can not be decoded
+/*!
+ * The image is decoded reduced(libjpeg does it during decoding),
+ * big images of formats which can not be decoded reduced are skipped.
+ * It is scaled down to 9x8 and every bit tells whether the pixel is brighter
+ * than its right neighbour. Resizing and recompression change only a few
+ * bits. It is safe to call this function from any thread.
+ */
+quint64
+DuplicateFinder::perceptualHash(const QString &aPath)
+{
+	ArchiveImageReader reader(aPath);
+	QSize size = reader.size();
+	if (reader.supportsOption(QImageIOHandler::ScaledSize) &&
+		size.isValid())
+	{
+		size.scale(QSize(64, 64), Qt::KeepAspectRatioByExpanding);
+		reader.setScaledSize(size);
+	}
+	/* the image would have to be decoded as a whole */
+	else if (!size.isValid() ||
+		maxDecodedPixels < qint64(size.width()) * size.height())
+	{
+		return 0;
+		/* NOTREACHED */
+	}
+
+	QImage image = reader.read();
+	if (image.isNull()) {
+		qDebug() << "DuplicateFinder::perceptualHash: " <<
+			reader.errorString();
+		return 0;
+		/* NOTREACHED */
+	}
+
+	image = image.scaled(
+		9,
+		8,
+		Qt::IgnoreAspectRatio,
+		Qt::SmoothTransformation
+		).convertToFormat(QImage::Format_RGB32);
+
+	quint64 result = 0;
+	for (int y = 0; y < 8; y++) {
+		const QRgb *line = reinterpret_cast< const QRgb * >(image.scanLine(y));
+		for (int x = 0; x < 8; x++) {
+			result <<= 1;
+			if (qGray(line[x + 1]) < qGray(line[x]))
+				result |= 1;
+		}
+	}
+
+	/* 0 means "not computed", a flat image becomes 1 bit away from it */
+	return result ? result : 1;
+}
+
+//! Computes the hashes of anImage which are not computed yet
+/*!
+ * It is safe to call this function from any thread.
+ * \see ImageScanner::run()
+ */
+void
+DuplicateFinder::hashImage(Image &anImage)
+{
+	if (!anImage.content_hash_)
+		anImage.content_hash_ = contentHash(anImage.image_);
+	if (!anImage.perceptual_hash_)
+		anImage.perceptual_hash_ = perceptualHash(anImage.image_);
+}
+
+//! Returns the number of bits which differ in the perceptual hashes
+int
+DuplicateFinder::distance(quint64 aFirst, quint64 aSecond)
+{
+	quint64 bits = aFirst ^ aSecond;
+	int result = 0;
+	for (; bits; result++)
+		bits &= bits - 1;
+
+	return result;
+}
+
+//! Groups images which are exact or near duplicates of each other
+/*!
+ * \param[in] aContent content hashes of the images, 0 if not computed
+ * \param[in] aPerceptual perceptual hashes of the images, 0 if not computed
+ * \param[in] aMaxDistance how many bits the perceptual hashes of near
+ * duplicates can differ in, up to 3
+ *
+ * Returns groups of at least two images(numbers in aContent), images in
+ * a group and the groups themselves go in the order of the numbers.
+ *
+ * The perceptual hashes are split into four 16 bit bands and only the
+ * hashes sharing a band are compared: two hashes differing in 3 bits or
+ * less have at least one band equal, so no pair is missed and nothing
+ * close to n*n comparisons is made.
+ */
+QList< QVector< int > >
+DuplicateFinder::groups(
+	const QVector< quint64 > &aContent,
+	const QVector< quint64 > &aPerceptual,
+	int aMaxDistance
+)
+{
+	int count = qMin(aContent.count(), aPerceptual.count());
+	QVector< int > parents(count);
+	for (int i = 0; i < count; i++)
+		parents[i] = i;
+
+	/* exact duplicates and equal perceptual hashes */
+	QHash< quint64, int > contents;
+	QHash< quint64, int > pictures;
+	QVector< int > unique;
+	for (int i = 0; i < count; i++) {
+		if (aContent.at(i)) {
+			int first = contents.value(aContent.at(i), -1);
+			if (first < 0)
+				contents.insert(aContent.at(i), i);
+			else
+				joinSets(parents, first, i);
+		}
+
+		if (aPerceptual.at(i)) {
+			int first = pictures.value(aPerceptual.at(i), -1);
+			if (first < 0) {
+				pictures.insert(aPerceptual.at(i), i);
+				unique.append(i);
+			}
+			else
+				joinSets(parents, first, i);
+		}
+	}
+
+	/* near duplicates */
+	int maxDistance = qBound(0, aMaxDistance, 3);
+	for (int band = 0; maxDistance && band < 4; band++) {
+		QHash< quint16, QVector< int > > buckets;
+		foreach (int i, unique)
+			buckets[quint16(aPerceptual.at(i) >> (16 * band))].append(i);
+
+		QHash< quint16, QVector< int > >::const_iterator bucket;
+		for (bucket = buckets.constBegin(); bucket != buckets.constEnd(); ++bucket) {
+			const QVector< int > &images = bucket.value();
+			for (int i = 0; i < images.count(); i++) {
+				for (int j = i + 1; j < images.count(); j++) {
+					if (distance(
+							aPerceptual.at(images.at(i)),
+							aPerceptual.at(images.at(j))
+							) <= maxDistance)
+					{
+						joinSets(parents, images.at(i), images.at(j));
+					}
+				}
+			}
+		}
+	}
+
+	/* roots are the smallest numbers, so the groups come out sorted */
+	QHash< int, int > groupOfRoot;
+	QList< QVector< int > > result;
+	for (int i = 0; i < count; i++) {
+		int root = findSet(parents, i);
+		if (root == i)
+			continue;
+
+		int group = groupOfRoot.value(root, -1);
+		if (group < 0) {
+			group = result.count();
+			groupOfRoot.insert(root, group);
+			result.append(QVector< int >() << root);
+		}
+		result[group].append(i);
+	}
+
+	return result;
+}
+
+/*
+ *
+ */
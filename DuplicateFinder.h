@@ -0,0 +1,49 @@
+/*!
+ * \file DuplicateFinder.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __DUPLICATEFINDER_H__
+#define __DUPLICATEFINDER_H__
+
+#include "ImageScanner.h"
+
+#include <QString>
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+//! \brief Finds byte-identical and re-encoded copies of the same image.
+/*!
+ * Every image gets two hashes(see hashImage(Image &anImage)):
+ * - a content hash of the file bytes(XXH64), equal for exact copies;
+ * - a perceptual hash of the picture(difference hash of a 9x8 grayscale
+ * thumbnail), close for resized, recompressed or slightly edited copies.
+ *
+ * The hashes are computed by the ImageScanner if it is asked to and kept
+ * in the DatasetManifest, so every file is hashed once.
+ *
+ * \see ImageListModel::setDuplicateGroups()
+ */
+class DuplicateFinder
+{
+public:
+	static quint64 hash(const uchar *aData, qint64 aSize, quint64 aSeed = 0);
+	static quint64 contentHash(const QString &aPath);
+	static quint64 perceptualHash(const QString &aPath);
+	static void hashImage(Image &anImage);
+	static int distance(quint64 aFirst, quint64 aSecond);
+	static QList< QVector< int > > groups(
+		const QVector< quint64 > &aContent,
+		const QVector< quint64 > &aPerceptual,
+		int aMaxDistance = 3
+		);
+};
+
+#endif /* __DUPLICATEFINDER_H__ */
+
+/*
+ *
+ */
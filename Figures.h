@@ -0,0 +1,37 @@
+/*!
+ * \file Figures.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __FIGURES_H__
+#define __FIGURES_H__
+
+#include <QRect>
+#include <QPolygon>
+
+//! enum indicating the figure of selection
+enum Figure {
+	NoFigure,
+	RectFigure,
+	PolyFigure
+};
+
+//! structure containing rectangle and it's label ID
+struct BoundingBox {
+	QRect rect;
+	int label_ID_;
+};
+
+//! structure containing list of the polygon points and polygon's label ID
+struct Polygon {
+	QPolygon poly;
+	int label_ID_;
+};
+
+#endif /* __FIGURES_H__ */
+
+/*
+ *
+ */
@@ -0,0 +1,748 @@
+/*
+ * ImageArchive.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ImageArchive.h"
+#include "functions.h"
+
+#include <QtConcurrentMap>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QDataStream>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QtEndian>
+#include <QDebug>
+
+/* "ILAI" - Image Labeler Archive Index */
+static const quint32 indexMagic = 0x494c4149;
+static const quint32 indexVersion = 1;
+
+/* tar headers and data are aligned to blocks */
+static const qint64 tarBlock = 512;
+
+/* zip signatures */
+static const quint32 zipLocalHeader = 0x04034b50;
+static const quint32 zipCentralHeader = 0x02014b50;
+static const quint32 zipEndOfDirectory = 0x06054b50;
+
+//! All the archives opened by the program
+struct ArchiveRegistry {
+	~ArchiveRegistry() { qDeleteAll(archives_); }
+
+	QMutex mutex_;
+	QHash< QString, ImageArchive * > archives_;
+};
+
+Q_GLOBAL_STATIC(ArchiveRegistry, registry)
+
+//! Returns the string stored in the fixed size field of the tar header
+static QString
+tarString(const uchar *aField, int aLength)
+{
+	const char *field = reinterpret_cast< const char * >(aField);
+	return QString::fromUtf8(field, qstrnlen(field, aLength));
+}
+
+//! \brief Returns the number stored in the field of the tar header,
+//! octal or base-256(GNU extension for big files)
+static qint64
+tarNumber(const uchar *aField, int aLength)
+{
+	qint64 result = 0;
+	if (aField[0] & 0x80) {
+		result = aField[0] & 0x7f;
+		for (int i = 1; i < aLength; i++)
+			result = (result << 8) | aField[i];
+		return result;
+		/* NOTREACHED */
+	}
+
+	for (int i = 0; i < aLength; i++) {
+		if (' ' == aField[i] && !result)
+			continue;
+		if (aField[i] < '0' || '7' < aField[i])
+			break;
+		result = (result << 3) | (aField[i] - '0');
+	}
+
+	return result;
+}
+
+//! Returns true if the checksum of the tar header is right
+static bool
+tarChecksum(const uchar *aHeader)
+{
+	qint64 sum = 0;
+	for (int i = 0; i < tarBlock; i++) {
+		/* the checksum field itself is counted as spaces */
+		if (148 <= i && i < 156)
+			sum += ' ';
+		else
+			sum += aHeader[i];
+	}
+
+	return sum == tarNumber(aHeader + 148, 8);
+}
+
+//! Returns the path from the pax extended header, empty if there is none
+/*!
+ * Records look like "length key=value\n".
+ */
+static QString
+paxPath(const uchar *aData, qint64 aSize)
+{
+	qint64 position = 0;
+	while (position < aSize) {
+		qint64 length = 0;
+		qint64 i = position;
+		for (; i < aSize && '0' <= aData[i] && aData[i] <= '9'; i++)
+			length = length * 10 + (aData[i] - '0');
+
+		if (!length || aSize < position + length || ' ' != aData[i])
+			break;
+
+		QByteArray record(
+			reinterpret_cast< const char * >(aData + i + 1),
+			int(position + length - i - 2)
+			);
+		if (record.startsWith("path="))
+			return QString::fromUtf8(record.mid(5));
+
+		position += length;
+	}
+
+	return QString();
+}
+
+//! A constructor of the closed archive
+ImageArchive::ImageArchive()
+{
+	data_ = 0;
+	size_ = 0;
+	modified_ = 0;
+}
+
+//! A destructor unmapping the archive
+ImageArchive::~ImageArchive()
+{
+	if (data_)
+		file_.unmap(data_);
+}
+
+//! Maps the archive and reads or builds the index of its images
+/*!
+ * \param[in] aPath a path to the tar or zip file
+ *
+ * Only uncompressed(stored) members of zip archives can be read.
+ */
+bool
+ImageArchive::open(const QString &aPath)
+{
+	file_.setFileName(QFileInfo(aPath).absoluteFilePath());
+	if (!file_.open(QIODevice::ReadOnly)) {
+		qDebug() << "ImageArchive::open: can not open " << aPath;
+		return false;
+		/* NOTREACHED */
+	}
+
+	size_ = file_.size();
+	modified_ = QFileInfo(file_).lastModified().toTime_t();
+	data_ = size_ ? file_.map(0, size_) : 0;
+	if (!data_) {
+		qDebug() << "ImageArchive::open: can not map " << aPath;
+		return false;
+		/* NOTREACHED */
+	}
+
+	if (readIndex()) {
+		return true;
+		/* NOTREACHED */
+	}
+
+	bool indexed = 0;
+	if (aPath.endsWith(".zip", Qt::CaseInsensitive))
+		indexed = indexZip();
+	else
+		indexed = indexTar();
+
+	if (!indexed) {
+		members_.clear();
+		order_.clear();
+		return false;
+		/* NOTREACHED */
+	}
+
+	writeIndex();
+	return true;
+}
+
+//! Returns true if the archive is mapped
+bool
+ImageArchive::isOpen() const
+{
+	return data_;
+}
+
+//! Returns the absolute path to the archive
+QString
+ImageArchive::path() const
+{
+	return file_.fileName();
+}
+
+//! Returns paths of all the images in the archive in the order they are stored
+QStringList
+ImageArchive::members() const
+{
+	return order_;
+}
+
+//! Returns true if there is an image aMember in the archive
+bool
+ImageArchive::contains(const QString &aMember) const
+{
+	return members_.contains(aMember);
+}
+
+//! Returns the bytes of the member, the mapped memory is not copied
+QByteArray
+ImageArchive::data(const QString &aMember) const
+{
+	QHash< QString, ArchiveMember >::const_iterator found =
+		members_.find(aMember);
+	if (!data_ || found == members_.constEnd()) {
+		return QByteArray();
+		/* NOTREACHED */
+	}
+
+	return QByteArray::fromRawData(
+		reinterpret_cast< const char * >(data_ + found.value().offset_),
+		int(found.value().size_)
+		);
+}
+
+//! Returns the size of the member in bytes
+qint64
+ImageArchive::size(const QString &aMember) const
+{
+	return members_.value(aMember).size_;
+}
+
+//! Returns the modification time of the archive
+uint
+ImageArchive::modified() const
+{
+	return modified_;
+}
+
+//! Returns true if the file is a tar or a zip archive(by the extension)
+bool
+ImageArchive::isArchive(const QString &aPath)
+{
+	return aPath.endsWith(".tar", Qt::CaseInsensitive) ||
+		aPath.endsWith(".zip", Qt::CaseInsensitive);
+}
+
+//! Returns true if aPath refers to a member of an archive
+bool
+ImageArchive::isMemberPath(const QString &aPath)
+{
+	return splitPath(aPath, 0, 0);
+}
+
+//! Splits the path of the member into the archive and the path inside it
+/*!
+ * \param[in] aPath a path like "/data/shard.tar!/images/1.jpg"
+ * \param[out] anArchive "/data/shard.tar", can be 0
+ * \param[out] aMember "images/1.jpg", can be 0
+ */
+bool
+ImageArchive::splitPath(
+	const QString &aPath,
+	QString *anArchive,
+	QString *aMember
+)
+{
+	int separator = aPath.indexOf("!/");
+	while (0 <= separator) {
+		if (isArchive(aPath.left(separator))) {
+			if (anArchive)
+				*anArchive = aPath.left(separator);
+			if (aMember)
+				*aMember = aPath.mid(separator + 2);
+			return true;
+			/* NOTREACHED */
+		}
+		separator = aPath.indexOf("!/", separator + 1);
+	}
+
+	return false;
+}
+
+//! Returns the path referring to the member of the archive
+QString
+ImageArchive::memberPath(const QString &anArchive, const QString &aMember)
+{
+	return anArchive + QString("!/") + aMember;
+}
+
+//! Returns the opened archive, opens it if it is not opened yet
+/*!
+ * Returns 0 if the archive can not be opened.
+ */
+ImageArchive *
+ImageArchive::archive(const QString &anArchive)
+{
+	ArchiveRegistry *archives = registry();
+	if (!archives) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	QString path = QFileInfo(anArchive).absoluteFilePath();
+	QMutexLocker locker(&archives->mutex_);
+
+	ImageArchive *result = archives->archives_.value(path, 0);
+	if (result) {
+		return result;
+		/* NOTREACHED */
+	}
+
+	result = new ImageArchive;
+	if (!result->open(path)) {
+		delete result;
+		return 0;
+		/* NOTREACHED */
+	}
+
+	archives->archives_.insert(path, result);
+	return result;
+}
+
+//! Returns the bytes of the member referred by aPath
+QByteArray
+ImageArchive::memberData(const QString &aPath)
+{
+	QString archivePath;
+	QString member;
+	if (!splitPath(aPath, &archivePath, &member)) {
+		return QByteArray();
+		/* NOTREACHED */
+	}
+
+	ImageArchive *opened = archive(archivePath);
+	if (!opened) {
+		return QByteArray();
+		/* NOTREACHED */
+	}
+
+	return opened->data(member);
+}
+
+//! Returns true if the file or the member of the archive exists
+bool
+ImageArchive::exists(const QString &aPath)
+{
+	QString archivePath;
+	QString member;
+	if (!splitPath(aPath, &archivePath, &member))
+		return QFile::exists(aPath);
+
+	ImageArchive *opened = archive(archivePath);
+	return opened && opened->contains(member);
+}
+
+//! \brief Reads the size and the modification time of the file or
+//! the member of the archive(the modification time of the archive itself)
+bool
+ImageArchive::stat(const QString &aPath, qint64 *aSize, uint *aModified)
+{
+	QString archivePath;
+	QString member;
+	if (!splitPath(aPath, &archivePath, &member)) {
+		QFileInfo info(aPath);
+		*aSize = info.size();
+		*aModified = info.lastModified().toTime_t();
+		return info.exists();
+		/* NOTREACHED */
+	}
+
+	ImageArchive *opened = archive(archivePath);
+	if (!opened || !opened->contains(member)) {
+		*aSize = 0;
+		*aModified = 0;
+		return false;
+		/* NOTREACHED */
+	}
+
+	*aSize = opened->size(member);
+	*aModified = opened->modified();
+	return true;
+}
+
+//! Returns the path to the file with the labeling data for anImage
+/*!
+ * It is "image_labeled.dat" next to the ordinary image and
+ * "archive.tar.labels/path/in/archive/image_labeled.dat" for the member
+ * of the archive.
+ */
+QString
+ImageArchive::dataFile(const QString &anImage)
+{
+	QString archivePath;
+	QString member;
+	QString result;
+	if (splitPath(anImage, &archivePath, &member)) {
+		result = archivePath + QString(".labels/") +
+			alterFileName(member, "_labeled");
+	}
+	else
+		result = alterFileName(anImage, "_labeled");
+
+	result.append(".dat");
+	return result;
+}
+
+//! Returns all the images of the archive(runs in a worker thread)
+/*!
+ * Headers of the images are read in parallel the same way the
+ * ImageScanner does, images having data in the sidecar directory
+ * are marked as labeled.
+ */
+QList< Image >
+ImageArchive::loadImages(const QString &anArchive)
+{
+	QList< Image > images;
+	ImageArchive *opened = archive(anArchive);
+	if (!opened) {
+		return images;
+		/* NOTREACHED */
+	}
+
+	QSet< QString > dataFiles;
+	QDirIterator labels(
+		opened->path() + QString(".labels"),
+		QStringList("*.dat"),
+		QDir::Files,
+		QDirIterator::Subdirectories
+		);
+	while (labels.hasNext())
+		dataFiles.insert(labels.next());
+
+	foreach (const QString &member, opened->members()) {
+		Image image;
+		image.image_ = memberPath(opened->path(), member);
+		image.labeled_ = dataFiles.contains(dataFile(image.image_));
+		images.append(image);
+	}
+
+	QtConcurrent::blockingMap(images, ImageScanner::probeImage);
+
+	return images;
+}
+
+//! Walks through the headers of the tar archive
+/*!
+ * ustar, GNU long names and pax paths are understood, everything except
+ * regular files is skipped.
+ */
+bool
+ImageArchive::indexTar()
+{
+	QString longName;
+	qint64 offset = 0;
+	while (offset + tarBlock <= size_) {
+		const uchar *header = data_ + offset;
+
+		/* two empty blocks end the archive */
+		if (!header[0])
+			break;
+
+		if (!tarChecksum(header)) {
+			qDebug() << "ImageArchive::indexTar: " << path() <<
+				" is not a tar archive or is corrupted at " << offset;
+			return !order_.isEmpty();
+			/* NOTREACHED */
+		}
+
+		qint64 memberSize = tarNumber(header + 124, 12);
+		qint64 dataOffset = offset + tarBlock;
+		if (memberSize < 0 || size_ < dataOffset + memberSize) {
+			qDebug() << "ImageArchive::indexTar: " << path() <<
+				" is truncated";
+			break;
+		}
+
+		char type = header[156];
+		if ('L' == type) {
+			longName = tarString(data_ + dataOffset, int(memberSize));
+		}
+		else if ('x' == type) {
+			longName = paxPath(data_ + dataOffset, memberSize);
+		}
+		else {
+			QString name = longName;
+			if (name.isEmpty()) {
+				name = tarString(header, 100);
+				QString prefix = tarString(header + 345, 155);
+				if (!qstrncmp(reinterpret_cast< const char * >(header + 257), "ustar", 5) &&
+					!prefix.isEmpty())
+				{
+					name = prefix + QString("/") + name;
+				}
+			}
+
+			if ('0' == type || '\0' == type || '7' == type)
+				addMember(name, dataOffset, memberSize);
+			longName.clear();
+		}
+
+		offset = dataOffset + (memberSize + tarBlock - 1) / tarBlock * tarBlock;
+	}
+
+	return true;
+}
+
+//! Reads the central directory of the zip archive
+bool
+ImageArchive::indexZip()
+{
+	/* the end of the central directory is followed by a comment
+	 * up to 65535 bytes long */
+	qint64 end = -1;
+	for (qint64 i = size_ - 22; 0 <= i && size_ - 22 - 65535 <= i; i--) {
+		if (zipEndOfDirectory == qFromLittleEndian< quint32 >(data_ + i)) {
+			end = i;
+			break;
+		}
+	}
+
+	if (end < 0) {
+		qDebug() << "ImageArchive::indexZip: " << path() <<
+			" is not a zip archive";
+		return false;
+		/* NOTREACHED */
+	}
+
+	quint16 entries = qFromLittleEndian< quint16 >(data_ + end + 10);
+	quint32 directory = qFromLittleEndian< quint32 >(data_ + end + 16);
+	if (0xffff == entries || 0xffffffff == directory) {
+		qDebug() << "ImageArchive::indexZip: zip64 archives are not supported";
+		return false;
+		/* NOTREACHED */
+	}
+
+	int compressed = 0;
+	qint64 position = directory;
+	for (int i = 0; i < entries; i++) {
+		if (size_ < position + 46 ||
+			zipCentralHeader != qFromLittleEndian< quint32 >(data_ + position))
+		{
+			qDebug() << "ImageArchive::indexZip: " << path() <<
+				" is corrupted";
+			return false;
+			/* NOTREACHED */
+		}
+		const uchar *entry = data_ + position;
+
+		quint16 flags = qFromLittleEndian< quint16 >(entry + 8);
+		quint16 method = qFromLittleEndian< quint16 >(entry + 10);
+		quint32 memberSize = qFromLittleEndian< quint32 >(entry + 20);
+		quint16 nameLength = qFromLittleEndian< quint16 >(entry + 28);
+		quint16 extraLength = qFromLittleEndian< quint16 >(entry + 30);
+		quint16 commentLength = qFromLittleEndian< quint16 >(entry + 32);
+		qint64 local = qFromLittleEndian< quint32 >(entry + 42);
+
+		/* the name, the extra field and the comment follow the header */
+		qint64 next = position + 46 + nameLength + extraLength + commentLength;
+		if (size_ < next) {
+			qDebug() << "ImageArchive::indexZip: " << path() <<
+				" is truncated";
+			return false;
+			/* NOTREACHED */
+		}
+
+		const char *name = reinterpret_cast< const char * >(entry + 46);
+		QString memberName = (flags & 0x0800) ?
+			QString::fromUtf8(name, nameLength) :
+			QString::fromLocal8Bit(name, nameLength);
+		position = next;
+
+		/* decompressing would mean copying, stored members only */
+		if (method) {
+			compressed++;
+			continue;
+		}
+
+		if (size_ < local + 30 ||
+			zipLocalHeader != qFromLittleEndian< quint32 >(data_ + local))
+		{
+			continue;
+		}
+
+		qint64 dataOffset = local + 30 +
+			qFromLittleEndian< quint16 >(data_ + local + 26) +
+			qFromLittleEndian< quint16 >(data_ + local + 28);
+		if (size_ < dataOffset + memberSize)
+			continue;
+
+		addMember(memberName, dataOffset, memberSize);
+	}
+
+	if (compressed) {
+		qDebug() << "ImageArchive::indexZip: " << compressed <<
+			" compressed members of " << path() << " are skipped";
+	}
+
+	return true;
+}
+
+//! \brief Reads the index kept next to the archive, returns false if there
+//! is none or the archive has changed since it was written
+bool
+ImageArchive::readIndex()
+{
+	QFile file(indexFileName());
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	qint64 size = 0;
+	uint modified = 0;
+	quint32 count = 0;
+	stream >> magic >> version >> size >> modified >> count;
+	if (indexMagic != magic || indexVersion != version ||
+		size != size_ || modified != modified_)
+	{
+		return false;
+		/* NOTREACHED */
+	}
+
+	for (quint32 i = 0; i < count && QDataStream::Ok == stream.status(); i++) {
+		QString name;
+		ArchiveMember member;
+		stream >> name >> member.offset_ >> member.size_;
+		if (size_ < member.offset_ + member.size_)
+			break;
+		members_.insert(name, member);
+		order_.append(name);
+	}
+
+	if (QDataStream::Ok != stream.status() || quint32(order_.count()) != count) {
+		qDebug() << "ImageArchive::readIndex: " << file.fileName() <<
+			" is corrupted";
+		members_.clear();
+		order_.clear();
+		return false;
+		/* NOTREACHED */
+	}
+
+	return true;
+}
+
+//! Writes the index next to the archive, failing is not an error
+void
+ImageArchive::writeIndex() const
+{
+	QFile file(indexFileName());
+	if (!file.open(QIODevice::WriteOnly)) {
+		qDebug() << "ImageArchive::writeIndex: can not write " <<
+			file.fileName();
+		return;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << indexMagic << indexVersion << size_ << modified_ <<
+		quint32(order_.count());
+
+	foreach (const QString &name, order_) {
+		const ArchiveMember &member = members_[name];
+		stream << name << member.offset_ << member.size_;
+	}
+
+	if (QDataStream::Ok != stream.status()) {
+		qDebug() << "ImageArchive::writeIndex: can not write " <<
+			file.fileName();
+		file.remove();
+	}
+}
+
+//! Returns the path to the index kept next to the archive
+QString
+ImageArchive::indexFileName() const
+{
+	return path() + QString(".index");
+}
+
+//! Adds the member to the index if it is an image
+void
+ImageArchive::addMember(const QString &aName, qint64 anOffset, qint64 aSize)
+{
+	QString name = aName;
+	while (name.startsWith("./"))
+		name.remove(0, 2);
+
+	QString fileName = removePath(name);
+	if (fileName.isEmpty() ||
+		!QDir::match(ImageScanner::nameFilters(), fileName) ||
+		fileName.endsWith(".dat", Qt::CaseInsensitive) ||
+		fileName.contains("_segmented", Qt::CaseInsensitive))
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	ArchiveMember member;
+	member.offset_ = anOffset;
+	member.size_ = aSize;
+
+	if (!members_.contains(name))
+		order_.append(name);
+	members_.insert(name, member);
+}
+
+//! A constructor preparing the reader for the file or the member of archive
+/*!
+ * \param[in] aPath a path to the image or to the member of an archive
+ * \param[in] aFormat a format of the image, empty to detect it
+ */
+ArchiveImageReader::ArchiveImageReader(
+	const QString &aPath,
+	const QByteArray &aFormat
+)
+{
+	if (ImageArchive::isMemberPath(aPath)) {
+		buffer_.setData(ImageArchive::memberData(aPath));
+		buffer_.open(QIODevice::ReadOnly);
+		setDevice(&buffer_);
+	}
+	else
+		setFileName(aPath);
+
+	setFormat(aFormat);
+}
+
+//! A destructor detaching the reader from the buffer before it is gone
+ArchiveImageReader::~ArchiveImageReader()
+{
+	setDevice(0);
+}
+
+/*
+ *
+ */
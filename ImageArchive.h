@@ -0,0 +1,126 @@
+/*!
+ * \file ImageArchive.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __IMAGEARCHIVE_H__
+#define __IMAGEARCHIVE_H__
+
+#include "ImageScanner.h"
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QFile>
+#include <QBuffer>
+#include <QImageReader>
+
+//! Structure keeps where the member is located in the archive
+struct ArchiveMember {
+	ArchiveMember() : offset_(0), size_(0) {}
+
+	qint64 offset_;
+	qint64 size_;
+};
+
+//! \brief Images stored in a tar or an uncompressed zip archive.
+/*!
+ * The archive is memory mapped and its members are indexed once: the index
+ * of member offsets is kept next to the archive and is rebuilt only if the
+ * archive has changed. Images are decoded straight from the mapped memory
+ * (see ArchiveImageReader), nothing is extracted.
+ *
+ * A member is referred as "path/to/archive.tar!/path/in/archive.jpg", so
+ * such paths go through the image list like any other ones. The labeling
+ * data of the members is kept in the sidecar directory "archive.tar.labels"
+ * by the member path(see dataFile()).
+ *
+ * Archives are opened on demand and stay open till the program exits,
+ * all the static functions are safe to call from any thread.
+ *
+ * \see ImageLabeler::loadArchive()
+ */
+class ImageArchive
+{
+public:
+	ImageArchive();
+	~ImageArchive();
+
+	bool open(const QString &aPath);
+	bool isOpen() const;
+	QString path() const;
+	QStringList members() const;
+	bool contains(const QString &aMember) const;
+	QByteArray data(const QString &aMember) const;
+	qint64 size(const QString &aMember) const;
+	uint modified() const;
+
+	static bool isArchive(const QString &aPath);
+	static bool isMemberPath(const QString &aPath);
+	static bool splitPath(
+		const QString &aPath,
+		QString *anArchive,
+		QString *aMember
+		);
+	static QString memberPath(const QString &anArchive, const QString &aMember);
+	static ImageArchive *archive(const QString &anArchive);
+	static QByteArray memberData(const QString &aPath);
+	static bool exists(const QString &aPath);
+	static bool stat(const QString &aPath, qint64 *aSize, uint *aModified);
+	static QString dataFile(const QString &anImage);
+	static QList< Image > loadImages(const QString &anArchive);
+
+private:
+	bool indexTar();
+	bool indexZip();
+	bool readIndex();
+	void writeIndex() const;
+	QString indexFileName() const;
+	void addMember(const QString &aName, qint64 anOffset, qint64 aSize);
+
+	//! the archive file, mapped as a whole
+	QFile file_;
+
+	//! beginning of the mapped archive
+	uchar *data_;
+
+	//! size of the archive
+	qint64 size_;
+
+	//! modification time of the archive
+	uint modified_;
+
+	//! image members keyed by path inside the archive
+	QHash< QString, ArchiveMember > members_;
+
+	//! paths of the image members in the order they are stored
+	QStringList order_;
+};
+
+//! \brief QImageReader which reads the members of archives as well as
+//! ordinary files.
+/*!
+ * \see ImageArchive
+ */
+class ArchiveImageReader : public QImageReader
+{
+public:
+	ArchiveImageReader(
+		const QString &aPath,
+		const QByteArray &aFormat = QByteArray()
+		);
+	~ArchiveImageReader();
+
+private:
+	//! the member of the archive the image is read from
+	QBuffer buffer_;
+};
+
+#endif /* __IMAGEARCHIVE_H__ */
+
+/*
+ *
+ */
@@ -6,17 +6,58 @@
  */
 
 #include "ImageHolder.h"
+#include "ImagePyramid.h"
 #include "functions.h"
+#include "Instrumentation.h"
+
+#include <QtConcurrentRun>
 
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QPainter>
+#include <QPaintEvent>
+#include <QLineF>
 #include <QListWidgetItem>
 #include <qmath.h>
+#include <QtAlgorithms>
 #include <QScrollArea>
 #include <QScrollBar>
+#include <QTimer>
+#include <QElapsedTimer>
 #include <QDebug>
 
+//! Returns the number of the grid cell aCoordinate falls into
+static int
+gridCell(int aCoordinate, int aCellSize)
+{
+	if (aCoordinate < 0)
+		return -((-aCoordinate - 1) / aCellSize) - 1;
+
+	return aCoordinate / aCellSize;
+}
+
+//! Returns the key of the grid cell in ImageHolder::point_index_
+static quint64
+cellKey(int aColumn, int aRow)
+{
+	return (quint64(quint32(aColumn)) << 32) | quint32(aRow);
+}
+
+//! \brief Returns true if aPoint is preferred to anOther when both are
+//! at the same distance: polygons go first, then objects and points in
+//! the order they were created
+static bool
+precedes(const IndexedPoint &aPoint, const IndexedPoint &anOther)
+{
+	if (aPoint.figure_ != anOther.figure_)
+		return PolyFigure == aPoint.figure_ || NoFigure == anOther.figure_;
+
+	if (aPoint.figureID_ != anOther.figureID_)
+		return aPoint.figureID_ < anOther.figureID_;
+
+	return aPoint.pointID_ < anOther.pointID_;
+}
+
 //! A constructor initializing some variables
 ImageHolder::ImageHolder(QWidget *aParent)
 	: QLabel(aParent)
@@ -36,35 +77,146 @@ ImageHolder::ImageHolder(QWidget *aParent)
 	selected_point_ = -1;
 
 	list_bounding_box_ = 0;
+	list_polygon_ = 0;
 	main_label_ = 0;
+	image_ = 0;
 	//list_bounding_box_ = new QList< QRect >;
 
 	scale_ = 1;
+	geometry_scale_ = 0;
+	index_cell_ = 32;
 
 	point_radius_ = 6;
 
+	layer_scale_ = 0;
+	layer_main_label_ = -1;
+	layer_focused_ = -1;
+	layer_focused_type_ = NoFigure;
+
+	segmentation_visible_ = 0;
+	segmentation_scale_ = 0;
+	segmentation_alpha_ = 112;
+
+	lod_scale_ = 0;
+	lod_min_points_ = 64;
+	lod_watcher_ = new QFutureWatcher< QList< QPolygonF > >(this);
+	connect(
+		lod_watcher_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onPolygonsSimplified())
+		);
+
+	view_scale_ = 0;
+	view_smooth_ = 0;
+	panning_ = 0;
+	pan_timer_ = new QTimer(this);
+	pan_timer_->setSingleShot(true);
+	pan_timer_->setInterval(200);
+	connect(
+		pan_timer_,
+		SIGNAL(timeout()),
+		this,
+		SLOT(onPanFinished())
+		);
+
+	hud_visible_ = 0;
+	drawn_objects_ = 0;
+	culled_objects_ = 0;
+	hud_timer_ = new QTimer(this);
+	hud_timer_->setInterval(500);
+	connect(
+		hud_timer_,
+		SIGNAL(timeout()),
+		this,
+		SLOT(onHudTimer())
+		);
+
+	pyramid_ = new ImagePyramid(this);
+	connect(
+		pyramid_,
+		SIGNAL(levelReady(int)),
+		this,
+		SLOT(onImageUpdated())
+		);
+	connect(
+		pyramid_,
+		SIGNAL(tileReady(int, int, int)),
+		this,
+		SLOT(onImageUpdated())
+		);
+
 	setScaledContents(true);
 	setMouseTracking(true);
 }
-//! An empty destructor
+//! A destructor waiting for the polygons being simplified
 ImageHolder::~ImageHolder()
 {
+	lod_watcher_->waitForFinished();
 
 }
 
 //! An event which being automatically called after any change of the widget
 /*!
- * \see drawBoundingBoxes(QPainter *aPainter, QPen *aPen)
- * \see drawPolygons(QPainter *aPainter, QPen *aPen)
+ * \see updateLayer()
+ * \see drawBoundingBox(QPainter *aPainter, int anIndex)
+ * \see drawPolygon(QPainter *aPainter, int anIndex)
  *
  * It contains drawing of the confirmed and not confirmed selections either.
+ * Confirmed objects are copied from layer_, only the focused object and the
+ * not confirmed selection are drawn every time.
  */
 void
 ImageHolder::paintEvent(QPaintEvent *anEvent)
 {
+	/* refreshing the measurements is not measured, it would take
+	 * the place of the frames */
+	QElapsedTimer timer;
+	if (Instrumentation::isEnabled() &&
+		!(hud_visible_ && hud_rect_.contains(anEvent->rect())))
+	{
+		timer.start();
+	}
+	drawn_objects_ = 0;
+	culled_objects_ = 0;
+
 	QLabel::paintEvent(anEvent);
 
 	QPainter painter(this);
+	painter.setClipRegion(anEvent->region());
+
+	updateView();
+	QRect exposed = anEvent->rect() & view_rect_;
+	if (!exposed.isEmpty()) {
+		painter.drawPixmap(
+			exposed.topLeft(),
+			view_,
+			exposed.translated(-view_rect_.topLeft())
+			);
+	}
+
+	updateObjectGeometry();
+	simplifyPolygons();
+	updateSegmentation();
+	exposed = anEvent->rect() & segmentation_rect_;
+	if (!exposed.isEmpty()) {
+		painter.drawImage(
+			exposed.topLeft(),
+			segmentation_,
+			exposed.translated(-segmentation_rect_.topLeft())
+			);
+	}
+
+	updateLayer();
+	exposed = anEvent->rect() & layer_rect_;
+	if (!exposed.isEmpty()) {
+		painter.drawImage(
+			exposed.topLeft(),
+			layer_,
+			exposed.translated(-layer_rect_.topLeft())
+			);
+	}
+
 	painter.setRenderHint(QPainter::Antialiasing);
 	//painter.setRenderHint(QPainter::SmoothPixmapTransform);
 	QPen pen;
@@ -87,34 +239,863 @@ ImageHolder::paintEvent(QPaintEvent *anEvent)
 			painter.drawRect(bbox);
 		}
 		else if (PolygonTool == tool_) {
-			/* scaling */
-			QPoint point;
-			QPolygon poly = polygon_.poly;
-			for (int i = 0; i < poly.size(); i++) {
-				point.setX(poly.at(i).x());
-				point.setY(poly.at(i).y());
-				point *= scale_;
-				poly.remove(i);
-				poly.insert(i, point);
+			painter.drawPolygon(polygon_geometry_.device_poly_);
+		}
+	}
+
+	/* the focused object is not in the layer */
+	if (figureBounds(focused_selection_type_, focused_selection_).
+		intersects(anEvent->rect()))
+	{
+		if (RectFigure == focused_selection_type_)
+			drawBoundingBox(&painter, focused_selection_);
+		else
+			drawPolygon(&painter, focused_selection_);
+	}
+
+	if (timer.isValid()) {
+		Instrumentation::addSample("paint, ms", timer.nsecsElapsed() / 1000000.0);
+	}
+
+	/* the objects are drawn only when the layer is patched, the frames
+	 * copying it would report nothing but zeroes */
+	if (timer.isValid() && (drawn_objects_ || culled_objects_)) {
+		Instrumentation::addSample("layer patch, objects drawn", drawn_objects_);
+		Instrumentation::addSample("layer patch, objects culled", culled_objects_);
+	}
+
+	if (hud_visible_)
+		drawHud(&painter);
+}
+
+//! \brief Draws the measurements reported to Instrumentation in the top
+//! left corner of the visible part of the widget
+/*!
+ * \see setHudVisible(bool aVisible)
+ */
+void
+ImageHolder::drawHud(QPainter *aPainter)
+{
+	QStringList lines = Instrumentation::report();
+	if (lines.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QFontMetrics metrics = fontMetrics();
+	int textWidth = 0;
+	foreach (QString line, lines)
+		textWidth = qMax(textWidth, metrics.width(line));
+
+	const int margin = 4;
+	hud_rect_ = QRect(
+		visibleRegion().boundingRect().topLeft() + QPoint(8, 8),
+		QSize(
+			textWidth + 2 * margin,
+			lines.count() * metrics.lineSpacing() + 2 * margin
+			)
+		);
+
+	aPainter->save();
+	aPainter->setRenderHint(QPainter::Antialiasing, false);
+	aPainter->fillRect(hud_rect_, QColor(0, 0, 0, 176));
+	aPainter->setPen(Qt::white);
+	aPainter->setFont(font());
+
+	QPoint baseline = hud_rect_.topLeft() + QPoint(margin, margin + metrics.ascent());
+	foreach (QString line, lines) {
+		aPainter->drawText(baseline, line);
+		baseline.ry() += metrics.lineSpacing();
+	}
+
+	aPainter->restore();
+}
+
+//! \brief Brings layer_ up to date, only the parts of the layer where
+//! the objects were changed are redrawn
+/*!
+ * \see paintEvent(QPaintEvent *)
+ * \see patchLayer(const QRect &aRect)
+ *
+ * layer_ covers the visible part of the widget. When the widget is
+ * scrolled the part which stays visible is kept. Changes of the scale,
+ * the label colors or the main label redraw the whole layer.
+ */
+void
+ImageHolder::updateLayer()
+{
+	QRect visible = visibleRegion().boundingRect();
+	if (visible.isEmpty()) {
+		layer_ = QImage();
+		layer_rect_ = QRect();
+		return;
+		/* NOTREACHED */
+	}
+
+	int mainLabel = main_label_ ? *main_label_ : -1;
+	QList< uint > colors;
+	if (list_label_color_)
+		colors = *list_label_color_;
+
+	if (layer_scale_ != scale_ ||
+		layer_main_label_ != mainLabel ||
+		layer_colors_ != colors)
+	{
+		layer_scale_ = scale_;
+		layer_main_label_ = mainLabel;
+		layer_colors_ = colors;
+		layer_rect_ = QRect();
+	}
+
+	/* the object losing the focus goes to the layer and vice versa */
+	if (layer_focused_ != focused_selection_ ||
+		layer_focused_type_ != focused_selection_type_)
+	{
+		layer_dirty_ |= figureBounds(layer_focused_type_, layer_focused_);
+		layer_dirty_ |=
+			figureBounds(focused_selection_type_, focused_selection_);
+		layer_focused_ = focused_selection_;
+		layer_focused_type_ = focused_selection_type_;
+	}
+
+	if (visible != layer_rect_) {
+		layer_ = movedBuffer(layer_, layer_rect_, visible);
+
+		QVector< QRect > uncovered =
+			(QRegion(visible) - (visible & layer_rect_)).rects();
+		layer_rect_ = visible;
+		for (int i = 0; i < uncovered.count(); i++)
+			patchLayer(uncovered.at(i));
+	}
+
+	patchLayer(layer_dirty_);
+	layer_dirty_ = QRect();
+}
+
+//! \brief Brings segmentation_ up to date, only the parts where the objects
+//! were changed are rasterized again
+/*!
+ * \see paintEvent(QPaintEvent *)
+ * \see rasterizeSegmentation(const QRect &aRect)
+ *
+ * segmentation_ covers the visible part of the widget in its resolution,
+ * so it is rebuilt when the scale or the label colors change. When the
+ * widget is scrolled the part which stays visible is kept.
+ */
+void
+ImageHolder::updateSegmentation()
+{
+	QRect visible = visibleRegion().boundingRect();
+	if (!segmentation_visible_ || visible.isEmpty()) {
+		segmentation_ = QImage();
+		segmentation_rect_ = QRect();
+		segmentation_dirty_ = QRect();
+		return;
+		/* NOTREACHED */
+	}
+
+	QList< uint > colors;
+	if (list_label_color_)
+		colors = *list_label_color_;
+
+	if (segmentation_scale_ != scale_ || segmentation_colors_ != colors) {
+		segmentation_scale_ = scale_;
+		segmentation_colors_ = colors;
+		segmentation_rect_ = QRect();
+
+		/* label 0 is the background, it stays transparent */
+		palette_.fill(0, qMax(colors.count(), 1));
+		int alpha = segmentation_alpha_;
+		for (int i = 1; i < colors.count(); i++) {
+			QRgb color = colors.at(i);
+			palette_[i] = qRgba(
+				qRed(color) * alpha / 255,
+				qGreen(color) * alpha / 255,
+				qBlue(color) * alpha / 255,
+				alpha
+				);
+		}
+	}
+
+	if (visible != segmentation_rect_) {
+		segmentation_ =
+			movedBuffer(segmentation_, segmentation_rect_, visible);
+
+		QVector< QRect > uncovered =
+			(QRegion(visible) - (visible & segmentation_rect_)).rects();
+		segmentation_rect_ = visible;
+		for (int i = 0; i < uncovered.count(); i++)
+			rasterizeSegmentation(uncovered.at(i));
+	}
+
+	rasterizeSegmentation(segmentation_dirty_);
+	segmentation_dirty_ = QRect();
+}
+
+//! Fills aRect of segmentation_ with the colors of the labels
+/*!
+ * \param[in] aRect an area of the widget
+ *
+ * Every pixel of the widget takes the label of the image pixel under its
+ * center, so the image rows are labeled once for all the widget rows
+ * they cover by rasterizeRow(), the same one the segmented picture is
+ * saved with.
+ */
+void
+ImageHolder::rasterizeSegmentation(const QRect &aRect)
+{
+	QRect rect = aRect & segmentation_rect_;
+	if (rect.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	/* only the objects intersecting the rect are checked */
+	QList< BoundingBox * > boxes;
+	for (int i = 0; i < bbox_geometry_.count(); i++) {
+		if (bbox_geometry_.at(i).bounds_.intersects(rect))
+			boxes.append(list_bounding_box_->at(i));
+	}
+	QList< Polygon * > polys;
+	QVector< QRect > polyRects;
+	for (int i = 0; i < poly_geometry_.count(); i++) {
+		if (poly_geometry_.at(i).bounds_.intersects(rect)) {
+			polys.append(list_polygon_->at(i));
+			polyRects.append(poly_geometry_.at(i).poly_.boundingRect());
+		}
+	}
+
+	/* image columns under the centers of the widget pixels */
+	QVector< int > columns(rect.width());
+	for (int j = 0; j < rect.width(); j++)
+		columns[j] = int((rect.left() + j + 0.5) / scale_);
+	int first = columns.first();
+	int last = columns.last();
+	QVector< int > labels(last - first + 1);
+
+	int labeledRow = -1;
+	int paletteSize = palette_.count();
+	for (int i = rect.top(); i <= rect.bottom(); i++) {
+		int row = int((i + 0.5) / scale_);
+		if (row != labeledRow) {
+			rasterizeRow(
+				row,
+				first,
+				last,
+				boxes,
+				polys,
+				polyRects,
+				labels.data()
+				);
+			labeledRow = row;
+		}
+
+		/* palette lookup */
+		QRgb *line =
+			reinterpret_cast< QRgb * >(
+				segmentation_.scanLine(i - segmentation_rect_.top())
+				) + rect.left() - segmentation_rect_.left();
+		for (int j = 0; j < rect.width(); j++) {
+			int label = labels.at(columns.at(j) - first);
+			line[j] = (label < paletteSize) ? palette_.at(label) : 0;
+		}
+	}
+}
+
+//! Shows or hides the labels of the pixels as semi-transparent fill
+/*!
+ * \see updateSegmentation()
+ *
+ * It shows the same picture ImageLabeler::saveSegmentedPicture() saves
+ * without writing it to disk.
+ */
+void
+ImageHolder::setSegmentationVisible(bool aVisible)
+{
+	segmentation_visible_ = aVisible;
+	update();
+}
+
+//! returns true if the segmentation overlay is shown
+bool
+ImageHolder::isSegmentationVisible() const
+{
+	return segmentation_visible_;
+}
+
+//! \brief shows or hides the measurements of painting, hit-testing and
+//! caches over the image
+/*!
+ * \see drawHud(QPainter *aPainter)
+ *
+ * Instrumentation records nothing while the measurements are hidden.
+ */
+void
+ImageHolder::setHudVisible(bool aVisible)
+{
+	hud_visible_ = aVisible;
+	Instrumentation::setEnabled(aVisible);
+
+	if (aVisible) {
+		hud_timer_->start();
+	}
+	else {
+		hud_timer_->stop();
+		hud_rect_ = QRect();
+		Instrumentation::clear();
+	}
+
+	update();
+}
+
+//! returns true if the measurements are shown
+bool
+ImageHolder::isHudVisible() const
+{
+	return hud_visible_;
+}
+
+//! \brief Returns a transparent buffer covering aNewRect of the widget with
+//! the part of aBuffer(covering anOldRect) which stays inside aNewRect
+/*!
+ * \see updateLayer()
+ * \see updateSegmentation()
+ */
+QImage
+ImageHolder::movedBuffer(
+	const QImage &aBuffer,
+	const QRect &anOldRect,
+	const QRect &aNewRect
+)
+{
+	QImage buffer(aNewRect.size(), QImage::Format_ARGB32_Premultiplied);
+	buffer.fill(0);
+
+	QRect kept = aNewRect & anOldRect;
+	if (!kept.isEmpty() && !aBuffer.isNull()) {
+		QPainter painter(&buffer);
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.drawImage(
+			kept.topLeft() - aNewRect.topLeft(),
+			aBuffer,
+			kept.translated(-anOldRect.topLeft())
+			);
+	}
+
+	return buffer;
+}
+
+//! Redraws the confirmed objects intersecting aRect in layer_
+/*!
+ * \param[in] aRect an area of the widget
+ */
+void
+ImageHolder::patchLayer(const QRect &aRect)
+{
+	QRect rect = aRect & layer_rect_;
+	if (rect.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QPainter painter(&layer_);
+	painter.translate(-layer_rect_.topLeft());
+	painter.setClipRect(rect);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	painter.fillRect(rect, Qt::transparent);
+	painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	painter.setRenderHint(QPainter::Antialiasing);
+	painter.setFont(font());
+
+	drawBoundingBoxes(&painter, rect);
+	drawPolygons(&painter, rect);
+}
+
+//! \brief Returns the part of the widget the object of aFigure with anIndex
+//! is drawn in, empty rect if there is no such object
+QRect
+ImageHolder::figureBounds(Figure aFigure, int anIndex) const
+{
+	if (RectFigure == aFigure &&
+		0 <= anIndex && anIndex < bbox_geometry_.count())
+	{
+		return bbox_geometry_.at(anIndex).bounds_;
+		/* NOTREACHED */
+	}
+	else if (PolyFigure == aFigure &&
+		0 <= anIndex && anIndex < poly_geometry_.count())
+	{
+		return poly_geometry_.at(anIndex).bounds_;
+		/* NOTREACHED */
+	}
+
+	return QRect();
+}
+
+//! \brief Updates bbox_geometry_, poly_geometry_ and polygon_geometry_ for
+//! the objects which were changed since the last paint
+/*!
+ * \see paintEvent(QPaintEvent *)
+ *
+ * Every entry keeps a copy of the object it was computed for. The copy
+ * shares the data with the object until the object is changed, so the
+ * unchanged objects are checked in constant time. The old and the new
+ * areas of the changed objects are added to segmentation_dirty_ and to
+ * layer_dirty_ unless the object is not in the layer(the focused one).
+ */
+void
+ImageHolder::updateObjectGeometry()
+{
+	bool rescaled = (geometry_scale_ != scale_);
+	geometry_scale_ = scale_;
+
+	int count = list_bounding_box_ ? list_bounding_box_->count() : 0;
+	for (int i = count; i < bbox_geometry_.count(); i++) {
+		layer_dirty_ |= bbox_geometry_.at(i).bounds_;
+		segmentation_dirty_ |= bbox_geometry_.at(i).bounds_;
+	}
+	bbox_geometry_.resize(count);
+	for (int i = 0; i < count; i++) {
+		ObjectGeometry &geometry = bbox_geometry_[i];
+		BoundingBox *bbox = list_bounding_box_->at(i);
+		QRect old = geometry.bounds_;
+		bool edited =
+			cacheGeometry(bbox->rect, &geometry, rescaled) ||
+			bbox->label_ID_ != geometry.label_;
+		geometry.label_ = bbox->label_ID_;
+		if (!edited || rescaled)
+			continue;
+
+		QRect changed = old | geometry.bounds_;
+		segmentation_dirty_ |= changed;
+		if (!(RectFigure == layer_focused_type_ && i == layer_focused_))
+			layer_dirty_ |= changed;
+	}
+
+	count = list_polygon_ ? list_polygon_->count() : 0;
+	for (int i = count; i < poly_geometry_.count(); i++) {
+		layer_dirty_ |= poly_geometry_.at(i).bounds_;
+		segmentation_dirty_ |= poly_geometry_.at(i).bounds_;
+	}
+	poly_geometry_.resize(count);
+	for (int i = 0; i < count; i++) {
+		ObjectGeometry &geometry = poly_geometry_[i];
+		Polygon *poly = list_polygon_->at(i);
+		QRect old = geometry.bounds_;
+		bool edited =
+			cacheGeometry(poly->poly, &geometry, rescaled) ||
+			poly->label_ID_ != geometry.label_;
+		geometry.label_ = poly->label_ID_;
+		if (!edited || rescaled)
+			continue;
+
+		QRect changed = old | geometry.bounds_;
+		segmentation_dirty_ |= changed;
+		if (!(PolyFigure == layer_focused_type_ && i == layer_focused_))
+			layer_dirty_ |= changed;
+	}
+
+	cacheGeometry(polygon_.poly, &polygon_geometry_, rescaled);
+}
+
+//! \brief Recomputes aGeometry if aRect was changed or the image was
+//! rescaled, returns true if it was recomputed
+bool
+ImageHolder::cacheGeometry(
+	const QRect &aRect,
+	ObjectGeometry *aGeometry,
+	bool aRescaled
+) const
+{
+	if (!aRescaled && !aGeometry->bounds_.isNull() &&
+		aRect == aGeometry->rect_)
+	{
+		return false;
+		/* NOTREACHED */
+	}
+
+	QRect rect = aRect.normalized();
+	aGeometry->rect_ = aRect;
+	aGeometry->device_rect_ =
+		QRect(rect.topLeft() * scale_, rect.bottomRight() * scale_);
+	aGeometry->label_pos_ = aGeometry->device_rect_.topLeft() + QPoint(5, 5);
+	aGeometry->bounds_ = objectBounds(aGeometry->device_rect_);
+	return true;
+}
+
+//! \brief Recomputes aGeometry if aPoly was changed or the image was
+//! rescaled, returns true if it was recomputed
+bool
+ImageHolder::cacheGeometry(
+	const QPolygon &aPoly,
+	ObjectGeometry *aGeometry,
+	bool aRescaled
+) const
+{
+	if (!aRescaled && !aGeometry->bounds_.isNull() &&
+		aPoly == aGeometry->poly_)
+	{
+		return false;
+		/* NOTREACHED */
+	}
+
+	QPolygonF poly(aPoly.count());
+	double perimeter = 0;
+	for (int i = 0; i < aPoly.count(); i++) {
+		poly[i] = QPointF(aPoly.at(i)) * scale_;
+		if (i)
+			perimeter += QLineF(poly.at(i - 1), poly.at(i)).length();
+	}
+
+	/* the outline simplified at the previous scale is drawn rescaled till
+	 * the one for the new scale is ready, see simplifyPolygons() */
+	if (aPoly == aGeometry->poly_ && !aGeometry->lod_poly_.isEmpty() &&
+		scale_ < 1)
+	{
+		double ratio = scale_ / aGeometry->lod_scale_;
+		for (int i = 0; i < aGeometry->lod_poly_.count(); i++)
+			aGeometry->lod_poly_[i] *= ratio;
+	}
+	else {
+		aGeometry->lod_poly_ = QPolygonF();
+	}
+	aGeometry->lod_scale_ = scale_;
+	aGeometry->lod_fresh_ = 0;
+
+	aGeometry->poly_ = aPoly;
+	aGeometry->device_poly_ = poly;
+	aGeometry->dense_ = (perimeter < poly.count() * point_radius_);
+	aGeometry->device_rect_ = poly.boundingRect().toRect();
+	aGeometry->label_pos_ = aGeometry->device_rect_.center();
+	aGeometry->bounds_ = objectBounds(aGeometry->device_rect_);
+	return true;
+}
+
+//! \brief Starts simplifying the outlines of the dense polygons in the
+//! background when the image is zoomed out
+/*!
+ * \see onPolygonsSimplified()
+ *
+ * Outlines are simplified with the tolerance of half a pixel, so they look
+ * the same. The simplified outlines are used for drawing only, the focused
+ * polygon is always drawn with all its points.
+ */
+void
+ImageHolder::simplifyPolygons()
+{
+	if (1 <= scale_ || geometry_scale_ != scale_ ||
+		lod_watcher_->isRunning())
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	QList< QPolygonF > polys;
+	lod_polygons_.clear();
+	lod_sources_.clear();
+	for (int i = 0; i < poly_geometry_.count(); i++) {
+		const ObjectGeometry &geometry = poly_geometry_.at(i);
+		if (geometry.device_poly_.count() < lod_min_points_ ||
+			geometry.lod_fresh_ ||
+			(PolyFigure == focused_selection_type_ && focused_selection_ == i))
+		{
+			continue;
+		}
+
+		lod_polygons_.append(i);
+		lod_sources_.append(geometry.poly_);
+		polys.append(geometry.device_poly_);
+	}
+
+	if (polys.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	lod_scale_ = scale_;
+	lod_watcher_->setFuture(QtConcurrent::run(simplified, polys, 0.5));
+}
+
+//! Simplifies every polygon of aPolys(worker thread)
+QList< QPolygonF >
+ImageHolder::simplified(
+	const QList< QPolygonF > &aPolys,
+	const double &aTolerance
+)
+{
+	QList< QPolygonF > result;
+	foreach (QPolygonF poly, aPolys)
+		result.append(simplifyPolygon(poly, aTolerance));
+
+	return result;
+}
+
+//! \brief A slot member storing the outlines simplified in the background,
+//! the outlines of the polygons changed meanwhile are dropped
+/*!
+ * The polygons are redrawn in layer_ with the new outlines.
+ */
+void
+ImageHolder::onPolygonsSimplified()
+{
+	QList< QPolygonF > result = lod_watcher_->result();
+	QRect changed;
+	if (lod_scale_ == geometry_scale_) {
+		for (int i = 0; i < lod_polygons_.count() && i < result.count(); i++) {
+			int index = lod_polygons_.at(i);
+			if (poly_geometry_.count() <= index ||
+				poly_geometry_.at(index).poly_ != lod_sources_.at(i))
+			{
+				continue;
+			}
+
+			ObjectGeometry &geometry = poly_geometry_[index];
+			geometry.lod_poly_ = result.at(i);
+			geometry.lod_scale_ = lod_scale_;
+			geometry.lod_fresh_ = 1;
+			changed |= geometry.bounds_;
+		}
+	}
+
+	lod_polygons_.clear();
+	lod_sources_.clear();
+
+	if (!changed.isEmpty()) {
+		layer_dirty_ |= changed;
+		update(changed);
+	}
+
+	simplifyPolygons();
+}
+
+//! \brief Returns the part of the widget an object with the bounding
+//! rect aDeviceRect(in the widget coordinates) is drawn in
+/*!
+ * The label ID, the points of the focused object and the width of the pen
+ * are taken into account.
+ */
+QRect
+ImageHolder::objectBounds(const QRect &aDeviceRect) const
+{
+	QRect rect = aDeviceRect;
+
+	/* label IDs are drawn in 20x20 rects */
+	QRect bounds = rect;
+	bounds |= QRect(rect.topLeft() + QPoint(5, 5), QSize(20, 20));
+	bounds |= QRect(rect.center(), QSize(20, 20));
+
+	int margin = point_radius_ + 3;
+	return bounds.adjusted(-margin, -margin, margin, margin);
+}
+
+//! \brief Brings view_ up to date with the visible part of the widget
+/*!
+ * \see paintEvent(QPaintEvent *)
+ * \see drawImage(QPainter *aPainter, const QRect &anExposedRect)
+ *
+ * When the widget is scrolled the part of view_ which stays visible is
+ * moved and only the uncovered strips are drawn from the pyramid. The image
+ * is drawn with the fast filter while it is being panned and with the
+ * smooth one when the panning is over.
+ */
+void
+ImageHolder::updateView()
+{
+	QRect visible = visibleRegion().boundingRect();
+	if (visible.isEmpty()) {
+		view_ = QPixmap();
+		view_rect_ = QRect();
+		return;
+		/* NOTREACHED */
+	}
+
+	/* the smoothly drawn part is kept while panning */
+	bool smooth = !panning_;
+	if (view_scale_ != scale_ || (smooth && !view_smooth_)) {
+		view_scale_ = scale_;
+		view_smooth_ = smooth;
+		view_rect_ = QRect();
+	}
+	else if (!smooth) {
+		view_smooth_ = 0;
+	}
+
+	if (visible == view_rect_) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QPixmap view(visible.size());
+	view.fill(Qt::transparent);
+
+	QPainter painter(&view);
+	QRect kept = visible & view_rect_;
+	if (!kept.isEmpty()) {
+		painter.setCompositionMode(QPainter::CompositionMode_Source);
+		painter.drawPixmap(
+			kept.topLeft() - visible.topLeft(),
+			view_,
+			kept.translated(-view_rect_.topLeft())
+			);
+		painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	}
+
+	painter.translate(-visible.topLeft());
+	painter.setRenderHint(QPainter::SmoothPixmapTransform, smooth);
+	QVector< QRect > uncovered = (QRegion(visible) - kept).rects();
+	for (int i = 0; i < uncovered.count(); i++) {
+		painter.setClipRect(uncovered.at(i));
+		drawImage(&painter, uncovered.at(i));
+	}
+	painter.end();
+
+	view_ = view;
+	view_rect_ = visible;
+}
+
+//! \brief A slot member redrawing the image after some part of it was
+//! decoded or replaced
+void
+ImageHolder::onImageUpdated()
+{
+	view_rect_ = QRect();
+	update();
+}
+
+//! \brief A slot member switching to the fast filter while the image is
+//! being scrolled
+void
+ImageHolder::onScrolled()
+{
+	panning_ = 1;
+	pan_timer_->start();
+
+	/* scrolling moves the measurements drawn before along with the image */
+	if (hud_visible_)
+		update(visibleRegion().boundingRect());
+}
+
+//! \brief A slot member redrawing the measurements, they change even
+//! if nothing is repainted
+void
+ImageHolder::onHudTimer()
+{
+	if (hud_rect_.isEmpty())
+		update(visibleRegion().boundingRect());
+	else
+		update(hud_rect_);
+}
+
+//! A slot member redrawing the image with the smooth filter after panning
+void
+ImageHolder::onPanFinished()
+{
+	panning_ = 0;
+	update();
+}
+
+//! draws only those tiles of the image which intersect anExposedRect
+/*!
+ * \see ImagePyramid
+ *
+ * Tiles are taken from the pyramid level closest to scale_, so the cost
+ * of this function depends on the size of the exposed area only.
+ */
+void
+ImageHolder::drawImage(
+	QPainter *aPainter,
+	const QRect &anExposedRect
+)
+{
+	if (pyramid_->isNull() || anExposedRect.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int level = pyramid_->requestLevel(pyramid_->levelForScale(scale_));
+	if (level < 0) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QSize imageSize = pyramid_->size();
+	QSize levelSize = pyramid_->levelSize(level);
+
+	/* widget pixels per level pixel */
+	double scaleX = scale_ * imageSize.width() / levelSize.width();
+	double scaleY = scale_ * imageSize.height() / levelSize.height();
+
+	QRect exposed = anExposedRect.intersected(
+		QRect(0, 0, qRound(imageSize.width() * scale_),
+			qRound(imageSize.height() * scale_))
+		);
+	if (exposed.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int tileSize = pyramid_->tileSize();
+	int firstColumn = int(exposed.left() / scaleX) / tileSize;
+	int lastColumn = qMin(
+		(levelSize.width() - 1) / tileSize,
+		int(exposed.right() / scaleX) / tileSize
+		);
+	int firstRow = int(exposed.top() / scaleY) / tileSize;
+	int lastRow = qMin(
+		(levelSize.height() - 1) / tileSize,
+		int(exposed.bottom() / scaleY) / tileSize
+		);
+
+	/* drawn in place of the tiles which are not decoded yet */
+	QPixmap overview;
+	if (pyramid_->isTiled())
+		overview = pyramid_->overview();
+
+	for (int row = firstRow; row <= lastRow; row++) {
+		for (int column = firstColumn; column <= lastColumn; column++) {
+			QRect source = pyramid_->tileRect(level, column, row);
+			/* rounding both edges so neighbour tiles have no gaps */
+			QRect target(
+				QPoint(
+					qRound(source.left() * scaleX),
+					qRound(source.top() * scaleY)
+					),
+				QPoint(
+					qRound((source.right() + 1) * scaleX) - 1,
+					qRound((source.bottom() + 1) * scaleY) - 1
+					)
+				);
+			QPixmap tile = pyramid_->tile(level, column, row);
+			if (!tile.isNull()) {
+				aPainter->drawPixmap(target, tile);
+			}
+			else if (!overview.isNull()) {
+				double overviewScaleX =
+					double(overview.width()) / (imageSize.width() * scale_);
+				double overviewScaleY =
+					double(overview.height()) / (imageSize.height() * scale_);
+				QRectF overviewSource(
+					target.left() * overviewScaleX,
+					target.top() * overviewScaleY,
+					target.width() * overviewScaleX,
+					target.height() * overviewScaleY
+					);
+				aPainter->drawPixmap(QRectF(target), overview, overviewSource);
 			}
-			painter.drawPolygon(poly);
 		}
 	}
-
-	/* drawing bounding boxes */
-	drawBoundingBoxes(&painter, &pen);
-	drawPolygons(&painter, &pen);
 }
 
-//! draws only confirmed bounding boxes
+//! draws confirmed bounding boxes intersecting anExposedRect
 /*!
- * parameters of bboxes may vary depending on whether bbox is selected or not or
- * whether it's label is main or not.
+ * \see drawBoundingBox(QPainter *aPainter, int anIndex)
+ *
+ * The focused bounding box is skipped, it is drawn over layer_.
  */
 void
 ImageHolder::drawBoundingBoxes(
 	QPainter *aPainter,
-	QPen *aPen
+	const QRect &anExposedRect
 ) const
 {
 	if (0 == list_bounding_box_)
@@ -123,112 +1104,121 @@ ImageHolder::drawBoundingBoxes(
 		/* NOTREACHED */
 	}
 
-	Qt::PenStyle penStyle;
-	/* default width is hardcoded */
-	int width = 2;
-	/* drawing all the bboxes */
 	for (int i = 0; i < list_bounding_box_->size(); i++) {
-		penStyle = Qt::SolidLine;
-		int labelID = list_bounding_box_->at(i)->label_ID_;
+		if (RectFigure == focused_selection_type_ && focused_selection_ == i)
+			continue;
 
-		/* setting color for the label of current bbox */
-		if (labelID < list_label_color_->count())
-			aPen->setColor(QColor(list_label_color_->at(labelID)));
-		/* in case there is no color for such label */
-		else
-			aPen->setColor(QColor(Qt::white));
+		if (bbox_geometry_.at(i).bounds_.intersects(anExposedRect)) {
+			drawBoundingBox(aPainter, i);
+			drawn_objects_++;
+		}
+		else {
+			culled_objects_++;
+		}
+	}
+}
 
-		/* checking whether labeled area is of main label or not */
-		if (labelID == *main_label_)
-			width = 3;
-		else
-			width = 2;
+//! draws the confirmed bounding box number anIndex
+/*!
+ * parameters of bboxes may vary depending on whether bbox is selected or not or
+ * whether it's label is main or not.
+ */
+void
+ImageHolder::drawBoundingBox(
+	QPainter *aPainter,
+	int anIndex
+) const
+{
+	QPen pen;
+	Qt::PenStyle penStyle = Qt::SolidLine;
+	/* default width is hardcoded */
+	int width = 2;
+	int labelID = list_bounding_box_->at(anIndex)->label_ID_;
+
+	/* setting color for the label of current bbox */
+	if (labelID < list_label_color_->count())
+		pen.setColor(QColor(list_label_color_->at(labelID)));
+	/* in case there is no color for such label */
+	else
+		pen.setColor(QColor(Qt::white));
+
+	/* checking whether labeled area is of main label or not */
+	if (labelID == *main_label_)
+		width = 3;
+	else
+		width = 2;
+
+	/* changing the line style and width if current area is selected(focused) */
+	if (RectFigure == focused_selection_type_ &&
+		focused_selection_ == anIndex) {
+		penStyle = Qt::DotLine;
+		width = 3;
+	}
 
-		/* changing the line style and width if current area is selected(focused) */
-		if (RectFigure == focused_selection_type_ &&
-			focused_selection_ == i) {
-			penStyle = Qt::DotLine;
-			width = 3;
-		}
+	QRect rect = bbox_geometry_.at(anIndex).device_rect_;
 
-		/* scaling */
-		QRect rect = list_bounding_box_->at(i)->rect.normalized();
-		QPoint topLeft = rect.topLeft() * scale_;
-		QPoint bottomRight = rect.bottomRight() * scale_;
-
-		rect.setTopLeft(topLeft);
-		rect.setBottomRight(bottomRight);
-
-		if (focused_selection_ == i &&
-			focused_selection_type_ == RectFigure) {
-			QPen circPen;
-			circPen.setWidth(2);
-			circPen.setStyle(Qt::SolidLine);
-			circPen.setColor(aPen->color());
-			aPainter->setPen(circPen);
-			for (int j = 0; j < 4; j++) {
-				QPoint point;
-				/* getting the number of point mouse pointer hovered on */
-				if (!j) {
-					point = rect.topLeft();
-				}
-				else if (1 == j)
-				{
-					point = rect.topRight();
-				}
-				else if (2 == j)
-				{
-					point = rect.bottomRight();
-				}
-				else if (3 == j)
-				{
-					point = rect.bottomLeft();
-				}
-				/* if current point is hovered then fill it */
-				if (i == hovered_point_.figureID &&
-					j == hovered_point_.pointID &&
-					RectFigure == hovered_point_.figure) {
-					QBrush brush;
-					brush.setColor(aPen->color());
-					brush.setStyle(Qt::SolidPattern);
-					aPainter->setBrush(brush);
-				}
-				aPainter->drawEllipse(point, point_radius_, point_radius_);
-				aPainter->setBrush(Qt::NoBrush);
+	if (focused_selection_ == anIndex &&
+		focused_selection_type_ == RectFigure) {
+		QPen circPen;
+		circPen.setWidth(2);
+		circPen.setStyle(Qt::SolidLine);
+		circPen.setColor(pen.color());
+		aPainter->setPen(circPen);
+		for (int j = 0; j < 4; j++) {
+			QPoint point;
+			/* getting the number of point mouse pointer hovered on */
+			if (!j) {
+				point = rect.topLeft();
+			}
+			else if (1 == j)
+			{
+				point = rect.topRight();
+			}
+			else if (2 == j)
+			{
+				point = rect.bottomRight();
+			}
+			else if (3 == j)
+			{
+				point = rect.bottomLeft();
 			}
+			/* if current point is hovered then fill it */
+			if (anIndex == hovered_point_.figureID &&
+				j == hovered_point_.pointID &&
+				RectFigure == hovered_point_.figure) {
+				QBrush brush;
+				brush.setColor(pen.color());
+				brush.setStyle(Qt::SolidPattern);
+				aPainter->setBrush(brush);
+			}
+			aPainter->drawEllipse(point, point_radius_, point_radius_);
+			aPainter->setBrush(Qt::NoBrush);
 		}
+	}
 
-		aPen->setWidth(width);
-		aPen->setStyle(penStyle);
-		aPainter->setPen(*aPen);
-
-		aPainter->drawRect(rect);
-
-		/* drawing label ids of these boxes */
-		QString labelIDText =
-			QString("%1").arg(labelID);
+	pen.setWidth(width);
+	pen.setStyle(penStyle);
+	aPainter->setPen(pen);
 
-		aPainter->drawText(
-			rect.left() + 5,
-			rect.top() + 5,
-			20,
-			20,
-			Qt::AlignLeft,
-			labelIDText
-			);
-	}
+	aPainter->drawRect(rect);
 
+	/* drawing label ids of these boxes */
+	aPainter->drawStaticText(
+		bbox_geometry_.at(anIndex).label_pos_,
+		labelText(labelID)
+		);
 }
 
-//! draws only confirmed polygons
+//! draws confirmed polygons intersecting anExposedRect
 /*!
- * parameters of polygons may vary depending on whether poly is selected or not or
- * whether it's label is main or not.
+ * \see drawPolygon(QPainter *aPainter, int anIndex)
+ *
+ * The focused polygon is skipped, it is drawn over layer_.
  */
 void
 ImageHolder::drawPolygons(
 	QPainter *aPainter,
-	QPen *aPen
+	const QRect &anExposedRect
 ) const
 {
 	if (0 == list_polygon_)
@@ -237,89 +1227,137 @@ ImageHolder::drawPolygons(
 		/* NOTREACHED */
 	}
 
-	Qt::PenStyle penStyle = Qt::SolidLine;
-	/* default width is hardcoded */
-	int width = 2;
-	/* drawing all the polygons */
 	for (int i = 0; i < list_polygon_->size(); i++) {
-		penStyle = Qt::SolidLine;
-		int labelID = list_polygon_->at(i)->label_ID_;
-
-		/* setting color for the label of current bbox */
-		if (labelID < list_label_color_->count())
-			aPen->setColor(QColor(list_label_color_->at(labelID)));
-		/* in case there is no color for such label */
-		else
-			aPen->setColor(QColor(Qt::white));
-
-		/* checking whether labeled area is of main object or not */
-		if (labelID == *main_label_)
-			width = 3;
-		else
-			width = 2;
+		if (PolyFigure == focused_selection_type_ && focused_selection_ == i)
+			continue;
 
-		/* changing the line style and width if current area is selected(focused) */
-		if (PolyFigure == focused_selection_type_ &&
-			focused_selection_ == i) {
-			penStyle = Qt::DotLine;
-			width = 3;
+		if (poly_geometry_.at(i).bounds_.intersects(anExposedRect)) {
+			drawPolygon(aPainter, i);
+			drawn_objects_++;
+		}
+		else {
+			culled_objects_++;
 		}
+	}
+}
+
+//! draws the confirmed polygon number anIndex
+/*!
+ * parameters of polygons may vary depending on whether poly is selected or not or
+ * whether it's label is main or not.
+ */
+void
+ImageHolder::drawPolygon(
+	QPainter *aPainter,
+	int anIndex
+) const
+{
+	QPen pen;
+	Qt::PenStyle penStyle = Qt::SolidLine;
+	/* default width is hardcoded */
+	int width = 2;
+	int labelID = list_polygon_->at(anIndex)->label_ID_;
+
+	/* setting color for the label of current bbox */
+	if (labelID < list_label_color_->count())
+		pen.setColor(QColor(list_label_color_->at(labelID)));
+	/* in case there is no color for such label */
+	else
+		pen.setColor(QColor(Qt::white));
+
+	/* checking whether labeled area is of main object or not */
+	if (labelID == *main_label_)
+		width = 3;
+	else
+		width = 2;
+
+	/* changing the line style and width if current area is selected(focused) */
+	if (PolyFigure == focused_selection_type_ &&
+		focused_selection_ == anIndex) {
+		penStyle = Qt::DotLine;
+		width = 3;
+	}
 
-		QPoint point;
-		QPolygon poly = list_polygon_->at(i)->poly;
+	const ObjectGeometry &geometry = poly_geometry_.at(anIndex);
+	const QPolygonF &poly = geometry.device_poly_;
+	bool focused = (focused_selection_ == anIndex &&
+		focused_selection_type_ == PolyFigure);
+
+	/* in case if it's focused */
+	if (focused) {
+		QPen circPen;
+		circPen.setWidth(2);
+		circPen.setStyle(Qt::SolidLine);
+		circPen.setColor(pen.color());
+		aPainter->setPen(circPen);
 		for (int j = 0; j < poly.size(); j++) {
-			point.setX(poly.at(j).x());
-			point.setY(poly.at(j).y());
-			/* scaling */
-			point *= scale_;
-			poly.remove(j);
-			poly.insert(j, point);
-
-			/* in case if it's focused */
-			if (focused_selection_ == i &&
-				focused_selection_type_ == PolyFigure) {
-				QPen circPen;
-				circPen.setWidth(2);
-				circPen.setStyle(Qt::SolidLine);
-				circPen.setColor(aPen->color());
-				aPainter->setPen(circPen);
-				/* filling the point if it is hovered */
-				if ((j == hovered_point_.pointID &&
-					i == hovered_point_.figureID &&
-					PolyFigure == hovered_point_.figure) ||
-					j == selected_point_) {
-					QBrush brush;
-					brush.setColor(aPen->color());
-					brush.setStyle(Qt::SolidPattern);
-					aPainter->setBrush(brush);
-				}
-				aPainter->drawEllipse(point, point_radius_, point_radius_);
-				aPainter->setBrush(Qt::NoBrush);
+			bool marked = ((j == hovered_point_.pointID &&
+				anIndex == hovered_point_.figureID &&
+				PolyFigure == hovered_point_.figure) ||
+				j == selected_point_);
+
+			/* only marked points are drawn when they are too dense */
+			if (geometry.dense_ && !marked)
+				continue;
+
+			/* filling the point if it is hovered */
+			if (marked) {
+				QBrush brush;
+				brush.setColor(pen.color());
+				brush.setStyle(Qt::SolidPattern);
+				aPainter->setBrush(brush);
 			}
+			aPainter->drawEllipse(poly.at(j), point_radius_, point_radius_);
+			aPainter->setBrush(Qt::NoBrush);
 		}
+	}
 
-		aPen->setWidth(width);
-		aPen->setStyle(penStyle);
-		aPainter->setPen(*aPen);
+	pen.setWidth(width);
+	pen.setStyle(penStyle);
+	aPainter->setPen(pen);
 
+	if (focused || geometry.lod_poly_.isEmpty())
 		aPainter->drawPolygon(poly);
-		/* drawing label IDs of these polygons */
-		QString labelIDText =
-			QString("%1").arg(labelID);
-		QRect rect = poly.boundingRect();
-		int x = rect.center().x();
-		int y = rect.center().y();
-
-		aPainter->drawText(
-			x,
-			y,
-			20,
-			20,
-			Qt::AlignHCenter,
-			labelIDText
-			);
+	else
+		aPainter->drawPolygon(geometry.lod_poly_);
+	/* drawing label IDs of these polygons centered in 20 pixels */
+	const QStaticText &text = labelText(labelID);
+	aPainter->drawStaticText(
+		geometry.label_pos_ + QPointF((20 - text.size().width()) / 2, 0),
+		text
+		);
+}
+
+//! Drops the label IDs laid out with the old font
+void
+ImageHolder::changeEvent(QEvent *anEvent)
+{
+	QLabel::changeEvent(anEvent);
+
+	if (QEvent::FontChange == anEvent->type()) {
+		label_texts_.clear();
+		layer_rect_ = QRect();
+		update();
+	}
+}
+
+//! \brief Returns the label ID laid out for drawing, the layout is done
+//! once for every label
+/*!
+ * \see drawBoundingBox(QPainter *aPainter, int anIndex)
+ * \see drawPolygon(QPainter *aPainter, int anIndex)
+ */
+const QStaticText &
+ImageHolder::labelText(int aLabelID) const
+{
+	QHash< int, QStaticText >::iterator text = label_texts_.find(aLabelID);
+	if (text == label_texts_.end()) {
+		text = label_texts_.insert(aLabelID, QStaticText(QString::number(aLabelID)));
+		text->setTextFormat(Qt::PlainText);
+		text->prepare(QTransform(), font());
 	}
 
+	return *text;
 }
 
 //! Changes current state and setting new coordinates for the bbox
@@ -337,6 +1375,7 @@ ImageHolder::triggerBoundBox(
 	QRect *aNewRect
 	)
 {
+	QRect old = pointsRect(QPolygon(*aNewRect));
 	aNewRect->setCoords(
 			 anOldPos.x(),
 			 anOldPos.y(),
@@ -345,7 +1384,7 @@ ImageHolder::triggerBoundBox(
 	);
 
 	state_ = NewSelection;
-	repaint_needed_ = 1;
+	markDirty(old | pointsRect(QPolygon(*aNewRect)));
 }
 
 //! \brief Changes current state and adding a new point to the
@@ -364,7 +1403,7 @@ ImageHolder::triggerPolygon(
 {
 	*aNewPoly << aPoint;
 
-	repaint_needed_ = 1;
+	markDirty(vertexRect(*aNewPoly, aNewPoly->count() - 1));
 }
 
 //! \brief Puts focus on some of the selections(selected areas)
@@ -529,7 +1568,7 @@ ImageHolder::setMainLabelNum(int *aNum)
 
 //! Sets a pointer on the ImageLabeler::image_
 void
-ImageHolder::setImage(QPixmap *anImage)
+ImageHolder::setImage(QImage *anImage)
 {
 	if (0 == anImage) {
 		return;
@@ -537,6 +1576,60 @@ ImageHolder::setImage(QPixmap *anImage)
 	}
 
 	image_ = anImage;
+	reloadImage();
+}
+
+//! \brief Rebuilds the pyramid from ImageLabeler::image_
+//! should be called every time image_ was changed
+void
+ImageHolder::reloadImage()
+{
+	if (0 == image_) {
+		return;
+		/* NOTREACHED */
+	}
+
+	pyramid_->setImage(*image_);
+	onImageUpdated();
+}
+
+//! \brief Switches to drawing the image decoded by tiles from aSource
+//! instead of ImageLabeler::image_
+/*!
+ * \see TiledImageSource
+ * \see reloadImage()
+ */
+void
+ImageHolder::setImageSource(const TiledImageSource &aSource)
+{
+	pyramid_->setSource(aSource);
+	onImageUpdated();
+}
+
+//! \brief Shows a reduced preview of the image which is still being decoded
+/*!
+ * \see ImagePyramid::setPreview(const QSize &, int, const QImage &)
+ * \see ImageLabeler::openImageFile(const QString &aPath)
+ *
+ * imageSize() returns aSize right away, so all the selections keep the
+ * coordinates of the original image. reloadImage() replaces the preview.
+ */
+void
+ImageHolder::setPreview(
+	const QSize &aSize,
+	int aLevel,
+	const QImage &aPreview
+)
+{
+	pyramid_->setPreview(aSize, aLevel, aPreview);
+	onImageUpdated();
+}
+
+//! Returns the size of the image in the original resolution
+QSize
+ImageHolder::imageSize() const
+{
+	return pyramid_->size();
 }
 
 //! Sets a pointer to scroll area containing this widget
@@ -549,6 +1642,18 @@ ImageHolder::setScrollArea(QScrollArea *aPointer)
 	}
 
 	scroll_area_ = aPointer;
+	connect(
+		scroll_area_->horizontalScrollBar(),
+		SIGNAL(valueChanged(int)),
+		this,
+		SLOT(onScrolled())
+		);
+	connect(
+		scroll_area_->verticalScrollBar(),
+		SIGNAL(valueChanged(int)),
+		this,
+		SLOT(onScrolled())
+		);
 }
 
 //! Clears scale, state, bounding_box_ and polygon_
@@ -654,15 +1759,12 @@ ImageHolder::undo()
 		NewSelection == state_ &&
 		!polygon_.poly.isEmpty())
 	{
+		markDirty(vertexRect(polygon_.poly, polygon_.poly.count() - 1));
 		list_poly_history_.append(polygon_.poly.last());
 		polygon_.poly.pop_back();
-		repaint_needed_ = 1;
 	}
 
-	if (repaint_needed_) {
-		update();
-		repaint_needed_ = 0;
-	}
+	repaintDirty();
 }
 
 //! Brings back the last removed by undo() point
@@ -675,20 +1777,17 @@ ImageHolder::redo()
 	{
 		polygon_.poly.append(list_poly_history_.last());
 		list_poly_history_.pop_back();
-		repaint_needed_ = 1;
+		markDirty(vertexRect(polygon_.poly, polygon_.poly.count() - 1));
 	}
 
-	if (repaint_needed_) {
-		update();
-		repaint_needed_ = 0;
-	}
+	repaintDirty();
 }
 
 //! Checks whether mouse pointer is on some point of any object or not
 /*!
  * \see hovered_point_
- * \see drawBoundingBoxes(QPainter *aPainter, QPen *aPen)
- * \see drawPolygons(QPainter *aPainter, QPen *aPen)
+ * \see drawBoundingBox(QPainter *aPainter, int anIndex)
+ * \see drawPolygon(QPainter *aPainter, int anIndex)
  *
  * It simply checks all the points of all objects if mouse
  * pointer is hovered above any of them
@@ -696,6 +1795,8 @@ ImageHolder::redo()
 void
 ImageHolder::checkForPoints(QPoint *aPos)
 {
+	ScopedTiming timing("hit test, ms");
+
 	if ((!list_polygon_->count() &&
 		!list_bounding_box_->count()) ||
 		!aPos) {
@@ -703,72 +1804,308 @@ ImageHolder::checkForPoints(QPoint *aPos)
 		/* NOTREACHED */
 	}
 
-	int newRadius = 0;
-	int x = aPos->x();
-	int y = aPos->y();
-	/* center coordinates */
-	int xc = 0;
-	int yc = 0;
-	for (int i = 0; i < list_polygon_->count(); i++) {
-		QPolygon poly = list_polygon_->at(i)->poly;
-		for (int j = 0; j < poly.count(); j++) {
-			xc = poly.at(j).x();
-			yc = poly.at(j).y();
-			newRadius = qSqrt(qPow(x - xc, 2) + qPow(y - yc, 2));
-			if (newRadius <= point_radius_) {
-				hovered_point_.figure = PolyFigure;
-				hovered_point_.figureID = i;
-				hovered_point_.pointID = j;
-				repaint_needed_ = 1;
-				return;
-				/* NOTREACHED */
+	updatePointIndex();
+
+	/* the same reach as the integer distance not exceeding the radius had */
+	int reach = (point_radius_ + 1) * (point_radius_ + 1);
+	int nearest = reach;
+	IndexedPoint hovered;
+	hovered.figure_ = NoFigure;
+	hovered.figureID_ = -1;
+	hovered.pointID_ = -1;
+
+	int left = gridCell(aPos->x() - point_radius_, index_cell_);
+	int right = gridCell(aPos->x() + point_radius_, index_cell_);
+	int top = gridCell(aPos->y() - point_radius_, index_cell_);
+	int bottom = gridCell(aPos->y() + point_radius_, index_cell_);
+
+	for (int column = left; column <= right; column++) {
+		for (int row = top; row <= bottom; row++) {
+			QHash< quint64, QVector< IndexedPoint > >::const_iterator cell =
+				point_index_.constFind(cellKey(column, row));
+			if (point_index_.constEnd() == cell)
+				continue;
+
+			const QVector< IndexedPoint > &points = cell.value();
+			for (int i = 0; i < points.count(); i++) {
+				const IndexedPoint &point = points.at(i);
+				int dx = point.pos_.x() - aPos->x();
+				int dy = point.pos_.y() - aPos->y();
+				int distance = dx * dx + dy * dy;
+				if (reach <= distance)
+					continue;
+
+				if (distance < nearest ||
+					(distance == nearest && precedes(point, hovered)))
+				{
+					nearest = distance;
+					hovered = point;
+				}
 			}
 		}
 	}
 
-	for (int i = 0; i < list_bounding_box_->count(); i++) {
-		QRect rect = list_bounding_box_->at(i)->rect;
+	setHoveredPoint(hovered.figure_, hovered.figureID_, hovered.pointID_);
+}
 
-		for (int j = 0; j < 4; j++) {
-			if (!j) {
-				xc = rect.left();
-				yc = rect.top();
-			}
-			else if (1 == j)
-			{
-				xc = rect.right();
-				yc = rect.top();
-			}
-			else if (2 == j)
-			{
-				xc = rect.right();
-				yc = rect.bottom();
-			}
-			else if (3 == j)
-			{
-				xc = rect.left();
-				yc = rect.bottom();
-			}
+//! \brief Brings point_index_ up to date with list_bounding_box_ and
+//! list_polygon_
+/*!
+ * \see checkForPoints(QPoint *aPos)
+ *
+ * Objects are compared with the copies kept since they were indexed, the
+ * comparison of the untouched implicitly shared copy takes no time. Only
+ * the points which were moved are put into other cells, so dragging a point
+ * of a huge polygon costs as little as dragging a corner of a box.
+ * The index is built from scratch when objects were added or removed.
+ */
+void
+ImageHolder::updatePointIndex()
+{
+	int rectCount = list_bounding_box_ ? list_bounding_box_->count() : 0;
+	int polyCount = list_polygon_ ? list_polygon_->count() : 0;
+
+	if (rectCount != indexed_rects_.count() ||
+		polyCount != indexed_polys_.count())
+	{
+		point_index_.clear();
+		indexed_rects_ = QVector< QRect >(rectCount);
+		indexed_polys_ = QVector< QPolygon >(polyCount);
+
+		for (int i = 0; i < rectCount; i++) {
+			indexed_rects_[i] = list_bounding_box_->at(i)->rect;
+			reindexPoints(RectFigure, i, QPolygon(), corners(indexed_rects_.at(i)));
+		}
+
+		for (int i = 0; i < polyCount; i++) {
+			indexed_polys_[i] = list_polygon_->at(i)->poly;
+			reindexPoints(PolyFigure, i, QPolygon(), indexed_polys_.at(i));
+		}
+
+		return;
+		/* NOTREACHED */
+	}
+
+	for (int i = 0; i < rectCount; i++) {
+		const QRect &rect = list_bounding_box_->at(i)->rect;
+		if (rect == indexed_rects_.at(i))
+			continue;
 
+		reindexPoints(RectFigure, i, corners(indexed_rects_.at(i)), corners(rect));
+		indexed_rects_[i] = rect;
+	}
+
+	for (int i = 0; i < polyCount; i++) {
+		const QPolygon &poly = list_polygon_->at(i)->poly;
+		if (poly == indexed_polys_.at(i))
+			continue;
+
+		reindexPoints(PolyFigure, i, indexed_polys_.at(i), poly);
+		indexed_polys_[i] = poly;
+	}
+}
 
-			newRadius = qSqrt(qPow(x - xc, 2) + qPow(y - yc, 2));
-			if (newRadius <= point_radius_) {
-				hovered_point_.figure = RectFigure;
-				hovered_point_.figureID = i;
-				hovered_point_.pointID = j;
-				repaint_needed_ = 1;
-				return;
-				/* NOTREACHED */
+//! \brief Moves the points of the object which differ between anOldPoints
+//! and aNewPoints to the cells they belong to now
+void
+ImageHolder::reindexPoints(
+	Figure aFigure,
+	int aFigureID,
+	const QPolygon &anOldPoints,
+	const QPolygon &aNewPoints
+)
+{
+	for (int i = 0; i < anOldPoints.count(); i++) {
+		const QPoint &pos = anOldPoints.at(i);
+		if (i < aNewPoints.count() && aNewPoints.at(i) == pos)
+			continue;
+
+		quint64 key = cellKey(
+			gridCell(pos.x(), index_cell_),
+			gridCell(pos.y(), index_cell_)
+			);
+		QHash< quint64, QVector< IndexedPoint > >::iterator cell =
+			point_index_.find(key);
+		if (point_index_.end() == cell)
+			continue;
+
+		QVector< IndexedPoint > &points = cell.value();
+		for (int j = 0; j < points.count(); j++) {
+			const IndexedPoint &point = points.at(j);
+			if (aFigure == point.figure_ && aFigureID == point.figureID_ &&
+				i == point.pointID_)
+			{
+				points.remove(j);
+				break;
 			}
 		}
+
+		if (points.isEmpty())
+			point_index_.erase(cell);
 	}
 
-	hovered_point_.figure = NoFigure;
-	hovered_point_.figureID = -1;
-	hovered_point_.pointID = -1;
+	for (int i = 0; i < aNewPoints.count(); i++) {
+		const QPoint &pos = aNewPoints.at(i);
+		if (i < anOldPoints.count() && anOldPoints.at(i) == pos)
+			continue;
+
+		IndexedPoint point;
+		point.pos_ = pos;
+		point.figure_ = aFigure;
+		point.figureID_ = aFigureID;
+		point.pointID_ = i;
+
+		quint64 key = cellKey(
+			gridCell(pos.x(), index_cell_),
+			gridCell(pos.y(), index_cell_)
+			);
+		point_index_[key].append(point);
+	}
+}
+
+//! \brief Returns the corners of aRect in the order the points of
+//! the bounding box are numbered
+QPolygon
+ImageHolder::corners(const QRect &aRect)
+{
+	QPolygon points;
+	points <<
+		aRect.topLeft() <<
+		aRect.topRight() <<
+		aRect.bottomRight() <<
+		aRect.bottomLeft();
+
+	return points;
+}
+
+//! \brief Changes hovered_point_, the old and the new hovered points are
+//! repainted if they differ
+/*!
+ * \see checkForPoints(QPoint *aPos)
+ */
+void
+ImageHolder::setHoveredPoint(Figure aFigure, int aFigureID, int aPointID)
+{
+	if (aFigure == hovered_point_.figure &&
+		aFigureID == hovered_point_.figureID &&
+		aPointID == hovered_point_.pointID)
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	QRect old = hoveredPointRect();
+	hovered_point_.figure = aFigure;
+	hovered_point_.figureID = aFigureID;
+	hovered_point_.pointID = aPointID;
+	markDirty(old | hoveredPointRect());
+}
+
+//! Returns the part of the widget the hovered point is drawn in
+QRect
+ImageHolder::hoveredPointRect() const
+{
+	int figureID = hovered_point_.figureID;
+	int pointID = hovered_point_.pointID;
+	QPolygon points;
+
+	if (PolyFigure == hovered_point_.figure && list_polygon_ &&
+		0 <= figureID && figureID < list_polygon_->count())
+	{
+		points = list_polygon_->at(figureID)->poly;
+	}
+	else if (RectFigure == hovered_point_.figure && list_bounding_box_ &&
+		0 <= figureID && figureID < list_bounding_box_->count())
+	{
+		/* corners go in the same order as in drawBoundingBox() */
+		points = QPolygon(list_bounding_box_->at(figureID)->rect);
+	}
+
+	if (pointID < 0 || points.count() <= pointID) {
+		return QRect();
+		/* NOTREACHED */
+	}
+
+	return pointsRect(QPolygon() << points.at(pointID));
+}
+
+//! \brief Returns the part of the widget covering aPoints(in the image
+//! coordinates) together with the points drawn around them
+QRect
+ImageHolder::pointsRect(const QPolygon &aPoints) const
+{
+	if (aPoints.isEmpty()) {
+		return QRect();
+		/* NOTREACHED */
+	}
+
+	QRect rect = aPoints.boundingRect();
+	rect = QRect(rect.topLeft() * scale_, rect.bottomRight() * scale_);
+
+	int margin = point_radius_ + 3;
+	return rect.adjusted(-margin, -margin, margin, margin);
+}
+
+//! \brief Returns the part of the widget covering the point anIndex of
+//! aPoly together with both edges of the point
+QRect
+ImageHolder::vertexRect(const QPolygon &aPoly, int anIndex) const
+{
+	int count = aPoly.count();
+	if (anIndex < 0 || count <= anIndex) {
+		return QRect();
+		/* NOTREACHED */
+	}
+
+	/* polygons are drawn closed */
+	QPolygon points;
+	points <<
+		aPoly.at((anIndex + count - 1) % count) <<
+		aPoly.at(anIndex) <<
+		aPoly.at((anIndex + 1) % count);
+
+	return pointsRect(points);
+}
+
+//! Returns the part of the widget the label ID of aPoly is drawn in
+/*!
+ * \see drawPolygon(QPainter *aPainter, int anIndex)
+ */
+QRect
+ImageHolder::labelRect(const QPolygon &aPoly) const
+{
+	QRect rect = pointsRect(aPoly);
+	if (rect.isNull()) {
+		return QRect();
+		/* NOTREACHED */
+	}
+
+	return QRect(rect.center(), QSize(20, 20)).adjusted(-2, -2, 2, 2);
+}
+
+//! Adds aRect to the part of the widget repaintDirty() is going to repaint
+void
+ImageHolder::markDirty(const QRect &aRect)
+{
+	update_rect_ |= aRect;
 	repaint_needed_ = 1;
 }
 
+//! \brief Repaints the parts of the widget changed by the mouse events
+//! instead of the whole widget
+/*!
+ * \see markDirty(const QRect &aRect)
+ */
+void
+ImageHolder::repaintDirty()
+{
+	if (repaint_needed_ && !update_rect_.isEmpty())
+		update(update_rect_);
+
+	update_rect_ = QRect();
+	repaint_needed_ = 0;
+}
+
 //! Returns position index of the point in polygon
 /*!
  * \param[in] aPos point to insert into the polygon
@@ -857,6 +2194,8 @@ ImageHolder::keyPressEvent(QKeyEvent *anEvent)
 void
 ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 {
+	ScopedTiming timing("mouse move, ms");
+
 	QPoint pos = anEvent->pos() / scale_;
 	if (anEvent->pos().x() < 0)
 		pos.setX(0);
@@ -885,8 +2224,10 @@ ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 		NewSelection == state_ &&
 		(anEvent->buttons() & Qt::LeftButton))
 	{
-		polygon_.poly.setPoint(polygon_.poly.count() - 1, pos);
-		repaint_needed_ = 1;
+		int last = polygon_.poly.count() - 1;
+		QRect old = vertexRect(polygon_.poly, last);
+		polygon_.poly.setPoint(last, pos);
+		markDirty(old | vertexRect(polygon_.poly, last));
 	}
 
 	if (-1 != focused_selection_ &&
@@ -902,8 +2243,10 @@ ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 		hovered_point_.figureID == focused_selection_)
 	{
 		Polygon *poly = list_polygon_->at(hovered_point_.figureID);
-		poly->poly.setPoint(hovered_point_.pointID, pos);
-		repaint_needed_ = 1;
+		int point = hovered_point_.pointID;
+		QRect old = vertexRect(poly->poly, point) | labelRect(poly->poly);
+		poly->poly.setPoint(point, pos);
+		markDirty(old | vertexRect(poly->poly, point) | labelRect(poly->poly));
 	}
 
 	/* editing bounding boxes */
@@ -913,6 +2256,7 @@ ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 		(anEvent->buttons() & Qt::LeftButton))
 	{
 		BoundingBox *rect = list_bounding_box_->at(hovered_point_.figureID);
+		QRect old = objectBounds(pointsRect(QPolygon(rect->rect)));
 		if (0 == hovered_point_.pointID)
 			rect->rect.setTopLeft(pos);
 		else if (1 == hovered_point_.pointID)
@@ -922,21 +2266,21 @@ ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 		else if (3 == hovered_point_.pointID)
 				rect->rect.setBottomLeft(pos);
 
-		repaint_needed_ = 1;
+		markDirty(old | objectBounds(pointsRect(QPolygon(rect->rect))));
 	}
 
-	/* moving image when it's too big */
+	/* moving image when it's too big, the widget scrolls the drawn part
+	 * of it and the image is redrawn smoothly when the panning is over */
 	if ((anEvent->buttons() & Qt::MiddleButton) &&
 		(scroll_area_->size().height() < size().height() ||
 		scroll_area_->size().width() < size().width()))
 	{
-		QPoint globPos = mapToGlobal(pos);
-		QPoint prev = mapToGlobal(prev_cursor_pos_);
 		int horValue = scroll_area_->horizontalScrollBar()->value();
 		int verValue = scroll_area_->verticalScrollBar()->value();
 
-		QPoint delta = globPos - prev;
-		prev_cursor_pos_ = pos;
+		/* global positions do not move together with the widget */
+		QPoint delta = anEvent->globalPos() - pan_cursor_pos_;
+		pan_cursor_pos_ = anEvent->globalPos();
 
 		horValue += delta.x();
 		verValue += delta.y();
@@ -945,10 +2289,7 @@ ImageHolder::mouseMoveEvent(QMouseEvent *anEvent)
 		scroll_area_->verticalScrollBar()->setValue(verValue);
 	}
 
-	if (repaint_needed_) {
-		update();
-		repaint_needed_ = 0;
-	}
+	repaintDirty();
 }
 
 //! Event is automatically called on every mouse click
@@ -962,12 +2303,14 @@ ImageHolder::mousePressEvent(QMouseEvent *anEvent)
 {
 	/* remembering coordinates of the click */
 	prev_cursor_pos_ = anEvent->pos() / scale_;
+	pan_cursor_pos_ = anEvent->globalPos();
 
 	QPoint pos = anEvent->pos() / scale_;
 
 	if (anEvent->buttons() & Qt::LeftButton) {
 		/* clearing the selected area if it is not confirmed */
 		if (NewSelection == state_ && BoundingBoxTool == tool_) {
+			markDirty(pointsRect(QPolygon(bounding_box_.rect)));
 			bounding_box_.rect.setRect(-1, -1, 0, 0);
 			state_ = StandBy;
 		}
@@ -986,6 +2329,7 @@ ImageHolder::mousePressEvent(QMouseEvent *anEvent)
 			state_ = NewSelection;
 			emit selectionStarted();
 
+			markDirty(pointsRect(polygon_.poly));
 			polygon_.poly.clear();
 			if (PolygonTool == tool_) {
 				polygon_.poly << prev_cursor_pos_;
@@ -993,8 +2337,8 @@ ImageHolder::mousePressEvent(QMouseEvent *anEvent)
 		}
 
 		/* selecting a point */
+		int selected = selected_point_;
 		selected_point_ = -1;
-		repaint_needed_ = 1;
 		if (-1 != hovered_point_.figureID &&
 			!list_polygon_->isEmpty() &&
 			PolyFigure == hovered_point_.figure &&
@@ -1002,12 +2346,21 @@ ImageHolder::mousePressEvent(QMouseEvent *anEvent)
 		{
 			selected_point_ = hovered_point_.pointID;
 		}
-	}
 
-	if (repaint_needed_) {
-		update();
-		repaint_needed_ = 0;
+		if (selected != selected_point_ &&
+			PolyFigure == focused_selection_type_ &&
+			0 <= focused_selection_ &&
+			focused_selection_ < list_polygon_->count())
+		{
+			QPolygon poly = list_polygon_->at(focused_selection_)->poly;
+			if (0 <= selected && selected < poly.count())
+				markDirty(pointsRect(QPolygon() << poly.at(selected)));
+			if (0 <= selected_point_ && selected_point_ < poly.count())
+				markDirty(pointsRect(QPolygon() << poly.at(selected_point_)));
+		}
 	}
+
+	repaintDirty();
 }
 
 void
@@ -1030,14 +2383,12 @@ ImageHolder::mouseDoubleClickEvent(QMouseEvent *anEvent)
 			/* NOTREACHED */
 		}
 
+		QRect old = objectBounds(pointsRect(poly->poly));
 		poly->poly.insert(index, pos);
-		repaint_needed_ = 1;
+		markDirty(old | objectBounds(pointsRect(poly->poly)));
 	}
 
-	if (repaint_needed_) {
-		update();
-		repaint_needed_ = 0;
-	}
+	repaintDirty();
 }
 
 //! Event is automatically called on every mouse release
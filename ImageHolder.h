@@ -8,26 +8,16 @@
 #ifndef __IMAGEHOLDER_H__
 #define __IMAGEHOLDER_H__
 
-#include <QLabel>
-
-//! enum indicating the figure of selection
-enum Figure {
-	NoFigure,
-	RectFigure,
-	PolyFigure
-};
-
-//! structure containing rectangle and it's label ID
-struct BoundingBox {
-	QRect rect;
-	int label_ID_;
-};
+#include "Figures.h"
 
-//! structure containing list of the polygon points and polygon's label ID
-struct Polygon {
-	QPolygon poly;
-	int label_ID_;
-};
+#include <QLabel>
+#include <QVector>
+#include <QPolygonF>
+#include <QImage>
+#include <QPixmap>
+#include <QStaticText>
+#include <QHash>
+#include <QFutureWatcher>
 
 //! structure indicates hovered point and the object which belongs to this hovered point
 struct HoveredPoint {
@@ -36,6 +26,31 @@ struct HoveredPoint {
 	int pointID; /*!< number of the point in an object(rect or poly) */
 };
 
+//! \brief structure caching the geometry of an object scaled to the widget
+//! \see ImageHolder::updateObjectGeometry()
+struct ObjectGeometry {
+	QRect rect_; /*!< the bounding box the geometry was computed for */
+	QPolygon poly_; /*!< the polygon the geometry was computed for */
+	QRect device_rect_; /*!< the bounding box on the widget */
+	QPolygonF device_poly_; /*!< the polygon on the widget */
+	QPolygonF lod_poly_; /*!< device_poly_ simplified for drawing, empty if it is not simplified */
+	double lod_scale_; /*!< scale_ the lod_poly_ is scaled with */
+	bool lod_fresh_; /*!< the lod_poly_ was simplified at the current scale_ */
+	bool dense_; /*!< the points are too close to each other to be drawn */
+	QPoint label_pos_; /*!< top left corner of the box the label ID is drawn in */
+	int label_; /*!< label ID of the object the geometry was computed for */
+	QRect bounds_; /*!< the object with its label and points on the widget */
+};
+
+//! \brief structure keeping a point of an object in the grid index
+//! \see ImageHolder::updatePointIndex()
+struct IndexedPoint {
+	QPoint pos_; /*!< the point in the image coordinates */
+	Figure figure_; /*!< figure of the object which belongs to the point */
+	int figureID_; /*!< ID of the object in list_bounding_box_ or list_polygon_ */
+	int pointID_; /*!< number of the point in the object */
+};
+
 //! enum indicating the direction of zooming
 enum ZoomDirection {
 	NoZoom,
@@ -44,8 +59,11 @@ enum ZoomDirection {
 };
 
 class QListWidgetItem;
-class QPixmap;
+class QImage;
 class QScrollArea;
+class ImagePyramid;
+class TiledImageSource;
+class QTimer;
 
 //! \brief Widget containing loaded image.
 //! It makes drawing rectangles and polygons on the image possible.
@@ -62,7 +80,13 @@ protected:
 	void mouseDoubleClickEvent(QMouseEvent *anEvent);
 	void mouseReleaseEvent(QMouseEvent *anEvent);
 	void paintEvent (QPaintEvent *anEvent);
+	void changeEvent(QEvent *anEvent);
 
+	void drawImage(
+		QPainter *aPainter,
+		const QRect &anExposedRect
+		);
+	void updateView();
 	void triggerBoundBox(
 		const QPoint &aNewPos,
 		const QPoint &anOldPos,
@@ -74,13 +98,65 @@ protected:
 		);
 	void drawBoundingBoxes(
 		QPainter *aPainter,
-		QPen *aPen
+		const QRect &anExposedRect
+		) const;
+	void drawBoundingBox(
+		QPainter *aPainter,
+		int anIndex
 		) const;
 	void drawPolygons(
 		QPainter *aPainter,
-		QPen *aPen
+		const QRect &anExposedRect
+		) const;
+	void drawPolygon(
+		QPainter *aPainter,
+		int anIndex
 		) const;
+	void updateLayer();
+	void updateSegmentation();
+	void rasterizeSegmentation(const QRect &aRect);
+	void drawHud(QPainter *aPainter);
+	static QImage movedBuffer(
+		const QImage &aBuffer,
+		const QRect &anOldRect,
+		const QRect &aNewRect
+		);
+	void patchLayer(const QRect &aRect);
+	QRect figureBounds(Figure aFigure, int anIndex) const;
+	void updateObjectGeometry();
+	bool cacheGeometry(
+		const QRect &aRect,
+		ObjectGeometry *aGeometry,
+		bool aRescaled
+		) const;
+	bool cacheGeometry(
+		const QPolygon &aPoly,
+		ObjectGeometry *aGeometry,
+		bool aRescaled
+		) const;
+	QRect objectBounds(const QRect &aDeviceRect) const;
+	const QStaticText &labelText(int aLabelID) const;
+	void simplifyPolygons();
+	static QList< QPolygonF > simplified(
+		const QList< QPolygonF > &aPolys,
+		const double &aTolerance
+		);
 	void checkForPoints(QPoint *aPos);
+	void updatePointIndex();
+	void reindexPoints(
+		Figure aFigure,
+		int aFigureID,
+		const QPolygon &anOldPoints,
+		const QPolygon &aNewPoints
+		);
+	static QPolygon corners(const QRect &aRect);
+	void setHoveredPoint(Figure aFigure, int aFigureID, int aPointID);
+	QRect hoveredPointRect() const;
+	QRect pointsRect(const QPolygon &aPoints) const;
+	QRect vertexRect(const QPolygon &aPoly, int anIndex) const;
+	QRect labelRect(const QPolygon &aPoly) const;
+	void markDirty(const QRect &aRect);
+	void repaintDirty();
 	int posInPolygon(
 		QPoint *aPos,
 		QPolygon *aPoly
@@ -107,12 +183,22 @@ public:
 	void setLabelColorList(QList< uint > *aLabelColorList);
 	void setScrollArea(QScrollArea *aPointer);
 	void setMainLabelNum(int *aNum);
-	void setImage(QPixmap *anImage);
+	void setImage(QImage *anImage);
+	void reloadImage();
+	void setImageSource(const TiledImageSource &aSource);
+	void setPreview(
+		const QSize &aSize,
+		int aLevel,
+		const QImage &aPreview
+		);
+	QSize imageSize() const;
 	void scaleImage(ZoomDirection aDirection, const double &scaleFactor);
 	int focusedSelection() const;
 	Figure focusedSelectionType() const;
 	State state() const;
 	Tool tool() const;
+	bool isSegmentationVisible() const;
+	bool isHudVisible() const;
 
 
 public slots:
@@ -125,15 +211,28 @@ public slots:
 	void undo();
 	void redo();
 	void removeSelectedPoint();
+	void setSegmentationVisible(bool aVisible);
+	void setHudVisible(bool aVisible);
 
 signals:
 	void selectionStarted();
 	void areaEdited();
 
+private slots:
+	void onPolygonsSimplified();
+	void onImageUpdated();
+	void onScrolled();
+	void onPanFinished();
+	void onHudTimer();
+
 private:
 	//! flag for the internal use
 	bool repaint_needed_;
 
+	//! \brief the part of the widget changed by the current event
+	//! \see markDirty(const QRect &aRect)
+	QRect update_rect_;
+
 	//! \brief pointer to the list of ImageLabeler
 	//! \see ImageLabeler::list_bounding_box_
 	QList< BoundingBox * > *list_bounding_box_;
@@ -157,7 +256,37 @@ private:
 
 	//! \brief pointer to the object of ImageLabeler
 	//! \see ImageLabeler::image_
-	QPixmap *image_;
+	QImage *image_;
+
+	//! \brief tiled levels of image_ which are actually drawn
+	//! \see drawImage(QPainter *aPainter, const QRect &anExposedRect)
+	//! \see reloadImage()
+	ImagePyramid *pyramid_;
+
+	//! \brief the image drawn over the visible part of the widget
+	//! \see updateView()
+	QPixmap view_;
+
+	//! the part of the widget covered by view_
+	QRect view_rect_;
+
+	//! scale_ view_ was drawn with
+	double view_scale_;
+
+	//! true if view_ was drawn with the smooth filter
+	bool view_smooth_;
+
+	//! \brief true while the image is being scrolled, view_ is drawn with
+	//! the fast filter meanwhile
+	//! \see onScrolled()
+	bool panning_;
+
+	//! \brief ends panning_ when the image was not scrolled for a while
+	//! \see onPanFinished()
+	QTimer *pan_timer_;
+
+	//! the global position of the cursor panning the image
+	QPoint pan_cursor_pos_;
 
 	//! \brief pointer to the variable of ImageLabeler
 	//! \see ImageLabeler::main_label_
@@ -202,9 +331,129 @@ private:
 	//! \see scaleImage(ZoomDirection aDirection,double scaleFactor)
 	double scale_;
 
+	//! \brief areas of the widget the bounding boxes are drawn in
+	//! \see updateObjectGeometry()
+	QVector< ObjectGeometry > bbox_geometry_;
+
+	//! \brief areas of the widget the polygons are drawn in
+	//! \see updateObjectGeometry()
+	QVector< ObjectGeometry > poly_geometry_;
+
+	//! \brief polygon_ scaled to the widget
+	//! \see updateObjectGeometry()
+	ObjectGeometry polygon_geometry_;
+
+	//! scale_ the bbox_geometry_ and poly_geometry_ were computed for
+	double geometry_scale_;
+
+	//! \brief points of all the objects by the cells of a uniform grid
+	//! \see updatePointIndex()
+	QHash< quint64, QVector< IndexedPoint > > point_index_;
+
+	//! the bounding boxes as they were put into point_index_
+	QVector< QRect > indexed_rects_;
+
+	//! the polygons as they were put into point_index_
+	QVector< QPolygon > indexed_polys_;
+
+	//! size of the point_index_ cell in the image coordinates
+	int index_cell_;
+
+	//! \brief watches the outlines of the dense polygons being simplified
+	//! in the worker thread
+	//! \see simplifyPolygons()
+	QFutureWatcher< QList< QPolygonF > > *lod_watcher_;
+
+	//! indexes of the polygons being simplified
+	QList< int > lod_polygons_;
+
+	//! the polygons being simplified as they were when the job started
+	QList< QPolygon > lod_sources_;
+
+	//! scale_ the polygons being simplified were scaled with
+	double lod_scale_;
+
+	//! polygons with less points are never simplified
+	int lod_min_points_;
+
+	//! \brief confirmed objects except the focused one drawn over the
+	//! visible part of the widget
+	//! \see updateLayer()
+	QImage layer_;
+
+	//! the part of the widget covered by layer_
+	QRect layer_rect_;
+
+	//! \brief the part of the widget where the objects were changed
+	//! since layer_ was updated
+	QRect layer_dirty_;
+
+	//! scale_ layer_ was drawn with
+	double layer_scale_;
+
+	//! main label layer_ was drawn with
+	int layer_main_label_;
+
+	//! label colors layer_ was drawn with
+	QList< uint > layer_colors_;
+
+	//! focused object which is not drawn in layer_
+	int layer_focused_;
+
+	//! type of the layer_focused_
+	Figure layer_focused_type_;
+
+	//! \brief true if the labels of the pixels are shown
+	//! \see setSegmentationVisible(bool aVisible)
+	bool segmentation_visible_;
+
+	//! \brief labels of the pixels in the visible part of the widget
+	//! \see updateSegmentation()
+	QImage segmentation_;
+
+	//! the part of the widget covered by segmentation_
+	QRect segmentation_rect_;
+
+	//! \brief the part of the widget where the objects were changed
+	//! since segmentation_ was updated
+	QRect segmentation_dirty_;
+
+	//! scale_ segmentation_ was rasterized with
+	double segmentation_scale_;
+
+	//! label colors segmentation_ was rasterized with
+	QList< uint > segmentation_colors_;
+
+	//! \brief premultiplied semi-transparent colors of the labels
+	//! \see rasterizeSegmentation(const QRect &aRect)
+	QVector< QRgb > palette_;
+
+	//! opacity of the segmentation overlay
+	int segmentation_alpha_;
+
+	//! \brief label IDs laid out for drawing, filled on demand
+	//! \see labelText(int aLabelID)
+	mutable QHash< int, QStaticText > label_texts_;
+
+	//! \brief true if the measurements of painting and hit-testing are shown
+	//! \see setHudVisible(bool aVisible)
+	bool hud_visible_;
+
+	//! \brief refreshes the measurements shown while nothing is repainted
+	//! \see onHudTimer()
+	QTimer *hud_timer_;
+
+	//! the part of the widget the measurements were drawn in last time
+	QRect hud_rect_;
+
+	//! \brief numbers of the confirmed objects drawn into the layer_ and
+	//! skipped as not exposed during the current paintEvent(QPaintEvent *)
+	mutable int drawn_objects_;
+	mutable int culled_objects_;
+
 	//! \brief declares the radius of the selecltable point
-	//! \see drawBoundingBoxes(QPainter *aPainter,QPen *aPen)
-	//! \see drawPolygons(QPainter *aPainter,QPen *aPen)
+	//! \see drawBoundingBox(QPainter *aPainter, int anIndex)
+	//! \see drawPolygon(QPainter *aPainter, int anIndex)
 	int point_radius_;
 };
 
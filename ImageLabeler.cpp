@@ -10,6 +10,13 @@
  */
 
 #include "ImageLabeler.h"
+#include "TiledImageSource.h"
+#include "ImagePyramid.h"
+#include "ThumbnailCache.h"
+#include "ImageListModel.h"
+#include "DuplicateFinder.h"
+#include "ImageArchive.h"
+#include "ImageSorter.h"
 #include "functions.h"
 
 #include <QApplication>
@@ -17,9 +24,11 @@
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
+#include <QActionGroup>
 #include <QBoxLayout>
 #include <QGridLayout>
 #include <QPixmap>
+#include <QImage>
 #include <QLabel>
 #include <QCheckBox>
 #include <QScrollArea>
@@ -27,6 +36,9 @@
 #include <QButtonGroup>
 #include <QListWidget>
 #include <QListWidgetItem>
+#include <QListView>
+#include <QComboBox>
+#include <QFileInfo>
 #include <QDesktopWidget>
 #include <QFileDialog>
 #include <QColorDialog>
@@ -37,7 +49,57 @@
 #include <QFile>
 #include <QKeyEvent>
 #include <QSettings>
+#include <QVector>
+#include <QSet>
+#include <QTimer>
+#include <QHash>
+#include <QtAlgorithms>
+#include <QtConcurrentRun>
 #include <QDebug>
+#include <qmath.h>
+
+/* items of the combo_image_filter_ preceding the labels */
+enum ImageFilterItem {
+	AllImagesItem,
+	UnlabeledImagesItem,
+	DuplicateImagesItem,
+	FirstLabelItem
+};
+
+//! \brief Brings the label indexes of all the dataset roots up to date
+//! (runs in a worker thread)
+/*!
+ * \param[in] aRoots paths to the dataset roots
+ * \param[in] aLabeled labeled images of every root
+ */
+static LabelIndex
+buildLabelIndexes(
+	const QStringList &aRoots,
+	const QList< QList< Image > > &aLabeled
+)
+{
+	LabelIndex index;
+	for (int i = 0; i < aRoots.count() && i < aLabeled.count(); i++)
+		index.merge(LabelIndex::build(aRoots.at(i), aLabeled.at(i)));
+
+	return index;
+}
+
+//! Writes the index files of aRoots(runs in a worker thread)
+static void
+saveLabelIndexes(const LabelIndex &anIndex, const QStringList &aRoots)
+{
+	foreach (const QString &root, aRoots)
+		anIndex.save(root);
+}
+
+//! Loads the image from aPath(runs in a worker thread)
+static QImage
+readImage(const QString &aPath)
+{
+	ArchiveImageReader reader(aPath);
+	return reader.read();
+}
 
 //! A constructor of the main class
 /*!
@@ -58,17 +120,35 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	/*
 	 * Variables
 	 */
-	list_images_ = new QList< Image >;
+	list_images_ = new ImageListModel(this);
 
 	main_label_ = -1;
 	pure_data_ = 0;
+
+	image_loader_ = new QFutureWatcher< QImage >(this);
+
+	roots_count_ = 0;
+	current_root_ = 0;
+	images_found_ = 0;
+	dataset_watcher_ = new DatasetWatcher(this);
+	label_index_watcher_ = new QFutureWatcher< LabelIndex >(this);
+	label_index_saver_ = new QFutureWatcher< void >(this);
+	label_index_timer_ = new QTimer(this);
+	label_index_timer_->setSingleShot(true);
+	label_index_timer_->setInterval(2000);
+	duplicates_watcher_ = new QFutureWatcher< QList< QVector< int > > >(this);
+	archive_loader_ = new QFutureWatcher< QList< Image > >(this);
+	sorter_ = new QFutureWatcher< QVector< int > >(this);
+	list_generation_ = 0;
+
+	thumbnail_cache_ = new ThumbnailCache(this);
+	list_images_->setThumbnailCache(thumbnail_cache_);
 	//label_ID_ = -1;
 
 	/* options */
 	auto_color_generation_ = 0;
 
 	/* flags */
-	interrupt_search_ = 0;
 	unsaved_data_ = 0;
 
 	setMouseTracking(true);
@@ -92,6 +172,8 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	menu_pascal_->setTitle(tr("&Pascal"));
 	menu_view_ = new QMenu(menu_bar_);
 	menu_view_->setTitle(tr("&View"));
+	menu_sort_ = new QMenu(menu_bar_);
+	menu_sort_->setTitle(tr("S&ort images"));
 	menu_edit_ = new QMenu(menu_bar_);
 	menu_edit_->setTitle(tr("&Edit"));
 	menu_help_ = new QMenu(menu_bar_);
@@ -102,6 +184,8 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	action_open_image_->setText(tr("&Load image"));
 	action_open_images_ = new QAction(this);
 	action_open_images_->setText(tr("&Load images(recursively)"));
+	action_open_archive_ = new QAction(this);
+	action_open_archive_->setText(tr("Load images from &archive"));
 	action_open_labeled_image_ = new QAction(this);
 	action_open_labeled_image_->setText(tr("&Load labeled image"));
 	action_load_legend_ = new QAction(this);
@@ -129,6 +213,36 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	action_view_segmented_ = new QAction(this);
 	action_view_segmented_->setText(tr("&Segmented"));
 	action_view_segmented_->setEnabled(false);
+	action_segmentation_overlay_ = new QAction(this);
+	action_segmentation_overlay_->setText(tr("Segmentation &overlay"));
+	action_segmentation_overlay_->setToolTip(
+		tr("Fill the labeled areas with the colors of their labels"));
+	action_segmentation_overlay_->setCheckable(true);
+	action_view_thumbnails_ = new QAction(this);
+	action_view_thumbnails_->setText(tr("&Thumbnails"));
+	action_view_thumbnails_->setCheckable(true);
+	action_watch_folders_ = new QAction(this);
+	action_watch_folders_->setText(tr("&Watch folders"));
+	action_watch_folders_->setCheckable(true);
+	action_find_duplicates_ = new QAction(this);
+	action_find_duplicates_->setText(tr("Find &duplicates"));
+	action_find_duplicates_->setToolTip(
+		tr("Hash the images while loading folders to find duplicates"));
+	action_find_duplicates_->setCheckable(true);
+	group_image_order_ = new QActionGroup(this);
+	group_image_order_->addAction(tr("&Scan order"))->
+		setData(ImageSorter::ScanOrder);
+	group_image_order_->addAction(tr("&Natural order"))->
+		setData(ImageSorter::NaturalOrder);
+	group_image_order_->addAction(tr("&Modification time"))->
+		setData(ImageSorter::ModifiedOrder);
+	group_image_order_->addAction(tr("File si&ze"))->
+		setData(ImageSorter::SizeOrder);
+	group_image_order_->addAction(tr("&Labeled first"))->
+		setData(ImageSorter::LabeledFirstOrder);
+	foreach (QAction *action, group_image_order_->actions())
+		action->setCheckable(true);
+	group_image_order_->actions().first()->setChecked(true);
 	/* menu edit */
 	action_undo_ = new QAction(this);
 	action_undo_->setText(tr("&Undo"));
@@ -161,6 +275,7 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 
 	menu_load_->addAction(action_open_image_);
 	menu_load_->addAction(action_open_images_);
+	menu_load_->addAction(action_open_archive_);
 	menu_load_->addAction(action_open_labeled_image_);
 	menu_load_->addAction(action_load_legend_);
 	menu_save_->addAction(action_save_segmented_);
@@ -179,6 +294,13 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 
 	menu_view_->addAction(action_view_normal_);
 	menu_view_->addAction(action_view_segmented_);
+	menu_view_->addAction(action_segmentation_overlay_);
+	menu_view_->addSeparator();
+	menu_view_->addAction(action_view_thumbnails_);
+	menu_view_->addAction(action_watch_folders_);
+	menu_view_->addAction(action_find_duplicates_);
+	menu_view_->addMenu(menu_sort_);
+	menu_sort_->addActions(group_image_order_->actions());
 
 	menu_edit_->addAction(action_undo_);
 	menu_edit_->addAction(action_redo_);
@@ -255,11 +377,11 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	frame_labelbox_->setMidLineWidth(0);
 
 	/* just dummy */
-	image_ = new QPixmap(500, 500);
-	image_->fill(QColor(Qt::white));
+	image_ = new QImage(500, 500, QImage::Format_RGB32);
+	image_->fill(QColor(Qt::white).rgb());
 
 	image_holder_ = new ImageHolder;
-	image_holder_->setPixmap(*image_);
+	image_holder_->resize(image_->size());
 	image_holder_->setAlignment(Qt::AlignVCenter | Qt::AlignHCenter);
 	image_holder_->setSizePolicy(QSizePolicy::Minimum, QSizePolicy::Minimum);
 	image_holder_->setScaledContents(true);
@@ -273,14 +395,30 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	list_label_->setContextMenuPolicy(Qt::CustomContextMenu);
 	list_areas_ = new QListWidget(central_widget_);
 	list_areas_->setContextMenuPolicy(Qt::CustomContextMenu);
-	list_images_widget_ = new QListWidget(central_widget_);
-	list_images_widget_->setContextMenuPolicy(Qt::CustomContextMenu);
+	list_images_view_ = new QListView(central_widget_);
+	list_images_view_->setContextMenuPolicy(Qt::CustomContextMenu);
+	list_images_view_->setEditTriggers(QAbstractItemView::NoEditTriggers);
+	/* the view does not need to ask every row for its size */
+	list_images_view_->setUniformItemSizes(true);
+	list_images_view_->setModel(list_images_);
+	combo_image_filter_ = new QComboBox(central_widget_);
+	updateLabelFilter();
 
 	label_toolbox_ = new QLabel(tr("Tool box"), frame_toolbox_);
 	label_list_label_ = new QLabel(tr("Object labels:"), central_widget_);
 	label_list_areas_ = new QLabel(tr("Selected areas:"), central_widget_);
 	label_list_images_ = new QLabel(tr("Loaded images:"), central_widget_);
 
+	/* a widget with a "cancel" button to
+	 * give user an opportunity to stop the recursive search */
+	widget_search_ = new QWidget(0);
+	widget_search_->setWindowTitle(tr("Loading images"));
+	label_search_ = new QLabel(widget_search_);
+	button_cancel_search_ = new QPushButton(tr("Cancel"), widget_search_);
+	QVBoxLayout *layoutSearch = new QVBoxLayout(widget_search_);
+	layoutSearch->addWidget(label_search_);
+	layoutSearch->addWidget(button_cancel_search_);
+
 	/* buttons */
 	button_bound_box_tool_ = new QPushButton(frame_toolbox_);
 	button_bound_box_tool_->setText(tr("bbox"));
@@ -384,8 +522,10 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 	layout_imagelist_buttons_->addWidget(button_add_image_);
 	layout_imagelist_buttons_->addWidget(button_remove_image_);
 
-	layout_left_->addWidget(list_images_widget_);
-	list_images_widget_->setFixedWidth(200);
+	layout_left_->addWidget(combo_image_filter_);
+	combo_image_filter_->setFixedWidth(200);
+	layout_left_->addWidget(list_images_view_);
+	list_images_view_->setFixedWidth(200);
 	layout_left_->addStretch(1);
 	layout_left_->addWidget(button_confirm_selection_);
 
@@ -435,6 +575,30 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 		this,
 		SLOT(loadImages())
 		);
+	connect(
+		action_open_archive_,
+		SIGNAL(triggered()),
+		this,
+		SLOT(loadArchive())
+		);
+	connect(
+		archive_loader_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onArchiveLoaded())
+		);
+	connect(
+		group_image_order_,
+		SIGNAL(triggered(QAction *)),
+		this,
+		SLOT(sortImages())
+		);
+	connect(
+		sorter_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onImagesSorted())
+		);
 	connect(
 		action_open_image_,
 		SIGNAL(triggered()),
@@ -495,6 +659,18 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 		this,
 		SLOT(viewSegmented())
 		);
+	connect(
+		action_view_thumbnails_,
+		SIGNAL(toggled(bool)),
+		this,
+		SLOT(setThumbnailsVisible(bool))
+		);
+	connect(
+		action_segmentation_overlay_,
+		SIGNAL(toggled(bool)),
+		image_holder_,
+		SLOT(setSegmentationVisible(bool))
+		);
 	connect(
 		action_undo_,
 		SIGNAL(triggered()),
@@ -658,13 +834,13 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 		SLOT(labelListPopupMenu(const QPoint &))
 		);
 	connect(
-		list_images_widget_,
-		SIGNAL(itemDoubleClicked(QListWidgetItem *)),
+		list_images_view_,
+		SIGNAL(doubleClicked(const QModelIndex &)),
 		this,
-		SLOT(selectImage(QListWidgetItem *))
+		SLOT(selectImage(const QModelIndex &))
 		);
 	connect(
-		list_images_widget_,
+		list_images_view_,
 		SIGNAL(customContextMenuRequested(const QPoint &)),
 		this,
 		SLOT(imageListPopupMenu(const QPoint &))
@@ -723,6 +899,54 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 		this,
 		SLOT(onAreaEdit())
 		);
+	connect(
+		image_loader_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onImageLoaded())
+		);
+	connect(
+		button_cancel_search_,
+		SIGNAL(clicked()),
+		this,
+		SLOT(interruptSearch())
+		);
+	connect(
+		action_watch_folders_,
+		SIGNAL(toggled(bool)),
+		dataset_watcher_,
+		SLOT(setEnabled(bool))
+		);
+	connect(
+		dataset_watcher_,
+		SIGNAL(directoryUpdated(const QString &, const QList< Image > &)),
+		this,
+		SLOT(onDirectoryUpdated(const QString &, const QList< Image > &))
+		);
+	connect(
+		combo_image_filter_,
+		SIGNAL(currentIndexChanged(int)),
+		this,
+		SLOT(setImageFilter(int))
+		);
+	connect(
+		label_index_watcher_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onLabelIndexBuilt())
+		);
+	connect(
+		label_index_timer_,
+		SIGNAL(timeout()),
+		this,
+		SLOT(saveLabelIndex())
+		);
+	connect(
+		duplicates_watcher_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onDuplicatesFound())
+		);
 
 	QString settingsPath = aSettingsPath;
 	if (settingsPath.isEmpty())
@@ -730,6 +954,12 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
 
 	settings_ = new QSettings(settingsPath, QSettings::IniFormat, this);
 
+	/* thumbnails are kept next to the settings */
+	thumbnail_cache_->open(
+		QFileInfo(settings_->fileName()).absolutePath() +
+		QString("/ImageLabeler.thumbnails")
+		);
+
 	readSettings(settings_);
 
 	/* giving the pointers to some properties for image_holder_ */
@@ -752,10 +982,23 @@ ImageLabeler::ImageLabeler(QWidget *aParent, QString aSettingsPath) :
  */
 ImageLabeler::~ImageLabeler()
 {
+	foreach (ImageScanner *scanner, scanners_)
+		scanner->cancel();
+	foreach (ImageScanner *scanner, scanners_)
+		scanner->wait();
+	/* the index files are being written */
+	label_index_watcher_->waitForFinished();
+	flushLabelIndex();
+	label_index_saver_->waitForFinished();
+	duplicates_watcher_->waitForFinished();
+	archive_loader_->waitForFinished();
+	sorter_->waitForFinished();
+
 	delete action_quit_;
 	delete action_open_labeled_image_;
 	delete action_open_image_;
 	delete action_open_images_;
+	delete action_open_archive_;
 	delete action_load_legend_;
 	delete action_load_pascal_file_;
 	delete action_load_pascal_poly_;
@@ -764,6 +1007,11 @@ ImageLabeler::~ImageLabeler()
 	delete action_save_all_;
 	delete action_view_normal_;
 	delete action_view_segmented_;
+	delete action_view_thumbnails_;
+	delete action_watch_folders_;
+	delete action_find_duplicates_;
+	delete action_segmentation_overlay_;
+	delete group_image_order_;
 	delete action_undo_;
 	delete action_redo_;
 	delete action_bound_box_tool_;
@@ -778,6 +1026,7 @@ ImageLabeler::~ImageLabeler()
 	delete menu_save_;
 	delete menu_pascal_;
 	delete menu_file_;
+	delete menu_sort_;
 	delete menu_view_;
 	delete menu_edit_;
 	delete menu_help_;
@@ -822,9 +1071,11 @@ ImageLabeler::~ImageLabeler()
 	delete label_list_areas_;
 	delete label_toolbox_;
 	delete label_list_images_;
+	delete widget_search_;
 	delete list_areas_;
 	delete list_label_;
-	delete list_images_widget_;
+	delete combo_image_filter_;
+	delete list_images_view_;
 
 	delete layout_imagelist_buttons_;
 	delete layout_toolbox_;
@@ -850,7 +1101,6 @@ ImageLabeler::~ImageLabeler()
 		delete pure_data_;
 	}
 
-	delete list_images_;
 	delete settings_;
 }
 
@@ -869,6 +1119,21 @@ ImageLabeler::readSettings(QSettings *aSettings)
 		aSettings->value("/auto_label_color_generation", 0).toBool();
 	options_form_.setAutoColorGeneration(&auto_color_generation_);
 	PASCALpath_ = aSettings->value("/PASCAL_root_path", "").toString();
+	action_view_thumbnails_->setChecked(
+		aSettings->value("/show_thumbnails", 0).toBool()
+		);
+	action_watch_folders_->setChecked(
+		aSettings->value("/watch_folders", 0).toBool()
+		);
+	action_find_duplicates_->setChecked(
+		aSettings->value("/find_duplicates", 0).toBool()
+		);
+	action_segmentation_overlay_->setChecked(
+		aSettings->value("/segmentation_overlay", 0).toBool()
+		);
+	int order = aSettings->value("/image_order", 0).toInt();
+	foreach (QAction *action, group_image_order_->actions())
+		action->setChecked(order == action->data().toInt());
 	aSettings->endGroup();
 
 	return true;
@@ -897,6 +1162,23 @@ ImageLabeler::writeSettings(QSettings *aSettings)
 	aSettings->beginGroup("/global");
 	aSettings->setValue("/auto_label_color_generation", auto_color_generation_);
 	aSettings->setValue("/PASCAL_root_path", PASCALpath_);
+	aSettings->setValue(
+		"/show_thumbnails",
+		action_view_thumbnails_->isChecked()
+		);
+	aSettings->setValue(
+		"/watch_folders",
+		action_watch_folders_->isChecked()
+		);
+	aSettings->setValue(
+		"/find_duplicates",
+		action_find_duplicates_->isChecked()
+		);
+	aSettings->setValue(
+		"/segmentation_overlay",
+		action_segmentation_overlay_->isChecked()
+		);
+	aSettings->setValue("/image_order", imageOrder());
 	aSettings->endGroup();
 
 	return true;
@@ -919,22 +1201,13 @@ ImageLabeler::writeSettings()
  * the image, and two boolean flags:
  * labeled_ indicates whether it is labeled or not
  * pas_ indicates whether it was read from the PASCAL file or not
+ *
+ * The filter is reset, so the image opened by the user is always shown.
  */
 void
 ImageLabeler::addImage(Image *anImage)
 {
-	QListWidgetItem *newItem = new QListWidgetItem;
-
-	QString itemText = QString("%1: %2").
-		arg(list_images_widget_->count()).
-		arg(removePath(anImage->image_));
-	if (anImage->labeled_)
-		itemText.append(" #labeled");
-	if (anImage->pas_)
-		itemText.append(" #pas");
-	newItem->setText(itemText);
-
-	list_images_widget_->addItem(newItem);
+	combo_image_filter_->setCurrentIndex(AllImagesItem);
 	list_images_->append(*anImage);
 
 	button_remove_image_->setEnabled(true);
@@ -1530,77 +1803,6 @@ ImageLabeler::toggleLabelPriority(QListWidgetItem *anItem)
 	return true;
 }
 
-//! A protected member recursively getting all images from directory dir
-/*!
- * \param[in] dir a const QDir object indicating current directory
- *
- * Looking for images in the directory and adding them to the list at once
- *
- * Recursive search can be interrupted by interrupt_search flag being true;
- *
- * If there are any labeled images in the folder they will be loaded with all
- * corresponding data.
- */
-void
-ImageLabeler::getImagesFromDir(const QDir &dir)
-{
-	/* avoiding freezing during recursive search for files */
-	QApplication::processEvents();
-
-	/* interrupting */
-	if (interrupt_search_) {
-		clearAll();
-		return;
-	}
-
-	QStringList filenameFilter;
-	/* *.dat are included also but only to indicate labeled images */
-	filenameFilter <<
-		"*.jpeg" <<
-		"*.jpg" <<
-		"*.gif" <<
-		"*.png" <<
-		"*.bmp" <<
-		"*.tiff" <<
-		"*.dat"
-		;
-
-	QStringList listImages =
-		dir.entryList(filenameFilter, QDir::Files);
-
-	foreach (QString file, listImages) {
-		/* ignoring segmented images and .dat files */
-		if (file.contains("_segmented", Qt::CaseInsensitive) ||
-			file.contains(".dat", Qt::CaseInsensitive)) {
-			continue;
-		}
-
-		Image newImage;
-		newImage.image_ = dir.absoluteFilePath(file);
-		/* TODO: think about loading pascal files */
-		newImage.pas_ = 0;
-
-		/* checking if there is a data for current image */
-		QString labeled = alterFileName(file, "_labeled");
-		labeled = removePath(labeled);
-		labeled.append(".dat");
-		if (listImages.contains(labeled, Qt::CaseInsensitive))
-			newImage.labeled_ = 1;
-		else
-			newImage.labeled_ = 0;
-
-		addImage(&newImage);
-	}
-
-	/* recursively going into subdirectory */
-	QStringList listDir = dir.entryList(QDir::Dirs);
-	foreach (QString subdir, listDir) {
-		if ("." == subdir || ".." == subdir)
-			continue;
-		getImagesFromDir(QDir(dir.absoluteFilePath(subdir)));
-	}
-}
-
 //! \brief A slot member changing current image to the next one
 //! and clearing all the data(except legend)
 /*!
@@ -1621,7 +1823,7 @@ ImageLabeler::nextImage()
 		/* NOTREACHED */
 	}
 
-	if (list_images_widget_->count() - 1 == image_ID_) {
+	if (list_images_->count() - 1 == image_ID_) {
 		image_ID_ = 0;
 	}
 	else {
@@ -1634,7 +1836,7 @@ ImageLabeler::nextImage()
 		/* NOTREACHED */
 	}
 
-	list_images_widget_->setCurrentRow(image_ID_);
+	setCurrentImage(image_ID_);
 
 	if (current_image_.isEmpty()) {
 		return;
@@ -1646,9 +1848,8 @@ ImageLabeler::nextImage()
 	winTitle.append(current_image_);
 	setWindowTitle(winTitle);
 
-	image_->load(current_image_);
-	image_holder_->resize(image_->size());
-	image_holder_->setPixmap(*image_);
+	openImageFile(current_image_);
+	image_holder_->resize(image_holder_->imageSize());
 	list_bounding_box_.clear();
 	list_polygon_.clear();
 	list_areas_->clear();
@@ -1667,7 +1868,7 @@ ImageLabeler::nextImage()
 void
 ImageLabeler::prevImage()
 {
-	if (!list_images_widget_->count()) {
+	if (list_images_->isEmpty()) {
 		return;
 		/* NOTREACHED */
 	}
@@ -1677,14 +1878,15 @@ ImageLabeler::prevImage()
 		/* NOTREACHED */
 	}
 
-	if (!image_ID_) {
-		image_ID_ = list_images_widget_->count() - 1;
+	/* the current image could be hidden by the filter */
+	if (image_ID_ <= 0) {
+		image_ID_ = list_images_->count() - 1;
 	}
 	else {
 		image_ID_--;
 	}
 
-	list_images_widget_->setCurrentRow(image_ID_);
+	setCurrentImage(image_ID_);
 
 	if (!selectImage(image_ID_)) {
 		showWarning(tr("Next image is not available"));
@@ -1697,9 +1899,8 @@ ImageLabeler::prevImage()
 	winTitle.append(current_image_);
 	setWindowTitle(winTitle);
 
-	image_->load(current_image_);
-	image_holder_->resize(image_->size());
-	image_holder_->setPixmap(*image_);
+	openImageFile(current_image_);
+	image_holder_->resize(image_holder_->imageSize());
 	list_bounding_box_.clear();
 	list_polygon_.clear();
 	list_areas_->clear();
@@ -1722,7 +1923,7 @@ ImageLabeler::prevImage()
 void
 ImageLabeler::saveAllInfo()
 {
-	if (!list_images_widget_->count()) {
+	if (list_images_->isEmpty()) {
 		showWarning("You have not opened any image yet");
 		return;
 		/* NOTREACHED */
@@ -1766,7 +1967,7 @@ ImageLabeler::saveAllInfo()
 	objectsToXml(&doc, &root);
 
 	/* image size */
-	QSize imageSize = image_->size();
+	QSize imageSize = image_holder_->imageSize();
 	QString imageSizeString;
 	imageSizeString.append(QString("%1;%2").
 		arg(imageSize.width()).
@@ -1777,12 +1978,14 @@ ImageLabeler::saveAllInfo()
 	imageSizeElement.appendChild(imageSizeText);
 	root.appendChild(imageSizeElement);
 
-	/* pure data */
-	setPureData();
+	/* pure data, row by row so the whole array is never allocated */
 	QString pixelValues;
+	QVector< QRect > polyRects = polygonRects();
+	QVector< int > labels(imageSize.width());
 	for (int i = 0; i < imageSize.height(); i++) {
+		labelRow(i, imageSize.width(), polyRects, labels.data());
 		for (int j = 0; j < imageSize.width(); j++) {
-			pixelValues.append(QString("%1;").arg(pure_data_[i][j]));
+			pixelValues.append(QString("%1;").arg(labels.at(j)));
 		}
 		pixelValues.append("\n");
 	}
@@ -1797,28 +2000,36 @@ ImageLabeler::saveAllInfo()
 	 * XML part ends
 	 */
 
-	QFileDialog fileDialog(0, tr("Save all info"));
-	fileDialog.setAcceptMode(QFileDialog::AcceptSave);
-	fileDialog.setDefaultSuffix("dat");
-	fileDialog.setFileMode(QFileDialog::AnyFile);
-	QString dir = getPathFromFilename(current_image_);
+	QString filename;
 
-	/* altering the name of a new file */
-	QString newFileName = alterFileName(current_image_, "_labeled");
-	newFileName = removePath(newFileName);
+	/* members of archives have their data in the sidecar directory */
+	if (ImageArchive::isMemberPath(current_image_)) {
+		filename = ImageArchive::dataFile(current_image_);
+		QDir().mkpath(getPathFromFilename(filename));
+	}
+	else {
+		QFileDialog fileDialog(0, tr("Save all info"));
+		fileDialog.setAcceptMode(QFileDialog::AcceptSave);
+		fileDialog.setDefaultSuffix("dat");
+		fileDialog.setFileMode(QFileDialog::AnyFile);
+		QString dir = getPathFromFilename(current_image_);
 
-	fileDialog.selectFile(newFileName);
+		/* altering the name of a new file */
+		QString newFileName = alterFileName(current_image_, "_labeled");
+		newFileName = removePath(newFileName);
 
-	fileDialog.setDirectory(dir);
+		fileDialog.selectFile(newFileName);
 
-	QString filename;
-	if (fileDialog.exec()) {
-		filename = fileDialog.selectedFiles().last();
-	}
-	else {
-		//showWarning(tr("Can not open file dialog"));
-		return;
-		/* NOTREACHED */
+		fileDialog.setDirectory(dir);
+
+		if (fileDialog.exec()) {
+			filename = fileDialog.selectedFiles().last();
+		}
+		else {
+			//showWarning(tr("Can not open file dialog"));
+			return;
+			/* NOTREACHED */
+		}
 	}
 
 	if (filename.isEmpty()) {
@@ -1826,17 +2037,68 @@ ImageLabeler::saveAllInfo()
 		/* NOTREACHED */
 	}
 
-	QFile file(filename);
+	/* the file is replaced rather than rewritten in place: watchers of
+	 * the directory(see DatasetWatcher) are told only about the entries
+	 * created, removed or renamed */
+	QFile file(filename + QString(".new"));
 	if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
 		showWarning(tr("Can not open file for writing"));
 		return;
 		/* NOTREACHED */
 	}
 
-	file.write(xml.toLocal8Bit());
+	QByteArray data = xml.toLocal8Bit();
+	if (file.write(data) != data.size()) {
+		file.remove();
+		showWarning(tr("Can not open file for writing"));
+		return;
+		/* NOTREACHED */
+	}
 	file.close();
 
+	if (QFile::exists(filename) && !QFile::remove(filename)) {
+		file.remove();
+		showWarning(tr("Can not open file for writing"));
+		return;
+		/* NOTREACHED */
+	}
+
+	/* the data is kept in the .new file then */
+	if (!file.rename(filename)) {
+		showWarning(tr("Can not rename %1").arg(file.fileName()));
+		return;
+		/* NOTREACHED */
+	}
+
 	unsaved_data_ = 0;
+
+	/* keeping the label index up to date if the data was saved where
+	 * the scanner looks for it */
+	QString dataFile = ImageArchive::dataFile(current_image_);
+	if (QFileInfo(filename) != QFileInfo(dataFile)) {
+		return;
+		/* NOTREACHED */
+	}
+
+	IndexedImage indexed = LabelIndex::indexData(data);
+	indexed.annotation_ = ImageScanner::annotationKey(dataFile);
+	label_index_.setImage(current_image_, indexed);
+
+	int id = list_images_->idOfRow(image_ID_);
+	if (0 <= id && list_images_->imageById(id).image_ == current_image_) {
+		Image updated = list_images_->imageById(id);
+		updated.labeled_ = 1;
+		updated.annotation_ = indexed.annotation_;
+		list_images_->setImageById(id, updated);
+	}
+
+	QString root = datasetRoot(current_image_);
+	if (!root.isEmpty()) {
+		unsaved_index_roots_.insert(root);
+		label_index_timer_->start();
+	}
+
+	updateLabelFilter();
 }
 
 //! A slot member saving a segmented image from pure_data_ array
@@ -1854,8 +2116,6 @@ ImageLabeler::saveSegmentedPicture()
 		/* NOTREACHED */
 	}
 
-	setPureData();
-
 	QFileDialog fileDialog(0, tr("Save segmented picture"));
 	fileDialog.setAcceptMode(QFileDialog::AcceptSave);
 	fileDialog.setDefaultSuffix("png");
@@ -1879,8 +2139,7 @@ ImageLabeler::saveSegmentedPicture()
 		/* NOTREACHED */
 	}
 
-	QSize imageSize = image_holder_->pixmap()->size();
-	QImage newImage(imageSize, QImage::Format_RGB32);
+	QSize imageSize = image_holder_->imageSize();
 	bool generateColorsFlag = auto_color_generation_;
 	bool flag = 0;
 
@@ -1917,10 +2176,42 @@ ImageLabeler::saveSegmentedPicture()
 		generateColors();
 	}
 
-	for (int i = 0; i < imageSize.height(); i++)
+	/* a byte per pixel is enough for the usual number of labels */
+	bool indexed = list_label_colors_.count() <= 256;
+	QImage newImage(
+		imageSize,
+		indexed ? QImage::Format_Indexed8 : QImage::Format_RGB32
+		);
+	if (newImage.isNull()) {
+		showWarning(tr("The image is too big to save the segmented picture"));
+		return;
+		/* NOTREACHED */
+	}
+
+	if (indexed) {
+		QVector< QRgb > colorTable;
+		for (int i = 0; i < list_label_colors_.count(); i++)
+			colorTable.append(0xff000000 | list_label_colors_.at(i));
+		newImage.setColorTable(colorTable);
+	}
+
+	/* rasterizing row by row straight into the picture */
+	QVector< QRect > polyRects = polygonRects();
+	QVector< int > labels(imageSize.width());
+	for (int i = 0; i < imageSize.height(); i++) {
+		labelRow(i, imageSize.width(), polyRects, labels.data());
+		uchar *line = newImage.scanLine(i);
+		if (indexed) {
+			for (int j = 0; j < imageSize.width(); j++)
+				line[j] = labels.at(j);
+			continue;
+		}
+
+		QRgb *pixels = reinterpret_cast< QRgb * >(line);
 		for (int j = 0; j < imageSize.width(); j++) {
-			newImage.setPixel(j, i, list_label_colors_.at(pure_data_[i][j]));
+			pixels[j] = 0xff000000 | list_label_colors_.at(labels.at(j));
 		}
+	}
 
 	if (!newImage.save(filename, "png", 100)) {
 		showWarning(tr("An error occurred while saving the segmented image"));
@@ -2036,9 +2327,10 @@ ImageLabeler::loadInfo()
 		newImage.image_ = current_image_;
 		newImage.labeled_ = 1;
 		newImage.pas_ = 0;
+		ImageScanner::probeImage(newImage);
 		addImage(&newImage);
-		image_ID_ = list_images_widget_->count() - 1;
-		list_images_widget_->setCurrentRow(image_ID_);
+		image_ID_ = list_images_->count() - 1;
+		setCurrentImage(image_ID_);
 	}
 
 	unsaved_data_ = 0;
@@ -2094,7 +2386,7 @@ ImageLabeler::loadInfo(QString filename)
 					return false;
 					/* NOTREACHED */
 				}
-				if (!image_->load(string)) {
+				if (!openImageFile(string)) {
 					return false;
 					/* NOTREACHED */
 				}
@@ -2106,8 +2398,7 @@ ImageLabeler::loadInfo(QString filename)
 				setWindowTitle(winTitle);
 
 
-				image_holder_->resize(image_->size());
-				image_holder_->setPixmap(*image_);
+				image_holder_->resize(image_holder_->imageSize());
 			}
 			/* path to the segmented image */
 			if (element.tagName() == "segmented") {
@@ -2252,9 +2543,10 @@ ImageLabeler::loadPascalFile()
 		newImage.image_ = current_image_;
 		newImage.labeled_ = 1;
 		newImage.pas_ = 1;
+		ImageScanner::probeImage(newImage);
 		addImage(&newImage);
-		image_ID_ = list_images_widget_->count() - 1;
-		list_images_widget_->setCurrentRow(image_ID_);
+		image_ID_ = list_images_->count() - 1;
+		setCurrentImage(image_ID_);
 	}
 
 	unsaved_data_ = 0;
@@ -2417,7 +2709,7 @@ ImageLabeler::loadPascalFile(QString aFilename, QString aPath)
 		rootNode = rootNode.nextSibling();
 	}
 
-	if (!image_->load(path + "/JPEGImages/" + filename)) {
+	if (!openImageFile(path + "/JPEGImages/" + filename)) {
 		return false;
 		/* NOTREACHED */
 	}
@@ -2429,8 +2721,7 @@ ImageLabeler::loadPascalFile(QString aFilename, QString aPath)
 	winTitle.append(current_image_);
 	setWindowTitle(winTitle);
 
-	image_holder_->resize(image_->size());
-	image_holder_->setPixmap(*image_);
+	image_holder_->resize(image_holder_->imageSize());
 
 	unsaved_data_ = 0;
 	return true;
@@ -2631,17 +2922,19 @@ ImageLabeler::loadImage()
 	QDir dir(dirPath);
 	QStringList filter;
 	filter << "*.dat";
-	QStringList fileList = dir.entryList(filter, QDir::Files);
+	QSet< QString > fileList =
+		ImageScanner::dataFiles(dir.entryList(filter, QDir::Files));
 	QString labeled = alterFileName(filename, "_labeled");
 	labeled = removePath(labeled);
 	labeled.append(".dat");
-	if (fileList.contains(labeled, Qt::CaseInsensitive)) {
+	if (fileList.contains(ImageScanner::dataFileFor(filename))) {
 		labeled = dir.absoluteFilePath(labeled);
 		loadInfo(labeled);
 		Image *newImage = new Image;
 		newImage->image_ = filename;
 		newImage->labeled_ = 1;
 		newImage->pas_ = 0;
+		ImageScanner::probeImage(*newImage);
 		addImage(newImage);
 		enableTools();
 		return;
@@ -2662,19 +2955,20 @@ ImageLabeler::loadImage()
 //		/* NOTREACHED */
 //	}
 //	image_holder_->resize(image_->size());
-//	image_holder_->setPixmap(*image_);
+//	image_holder_->reloadImage();
 
 	current_image_ = filename;
-	image_ID_ = list_images_widget_->count() - 1;
-	list_images_widget_->setCurrentRow(image_ID_);
+	image_ID_ = list_images_->count() - 1;
+	setCurrentImage(image_ID_);
 
 	Image *newImage = new Image;
 	newImage->image_ = filename;
 	newImage->labeled_ = 0;
 	newImage->pas_ = 0;
+	ImageScanner::probeImage(*newImage);
 	addImage(newImage);
 
-	if (!list_images_widget_->count()) {
+	if (list_images_->isEmpty()) {
 		return;
 		/* NOTREACHED */
 	}
@@ -2684,11 +2978,16 @@ ImageLabeler::loadImage()
 
 //! A slot member loading images recursively
 /*!
- * \see getImagesFromDir(const QDir &dir)
+ * \see ImageScanner
+ * \see onImagesFound(int aGeneration, const QList< Image > &anImages)
  *
  * Slot asks for unsaved data.
- * It gives user a possibility to break a recursive search(with the widget
- * and a button "cancel" on it.)
+ * Several folders can be selected, each of them is searched by its own
+ * scanner at the same time. Folders lying inside other selected folders
+ * are skipped, so every image is found only once.
+ * The search runs in the background and the images appear in the list
+ * while it goes on. It gives user a possibility to break a recursive
+ * search(with the widget and a button "cancel" on it.)
  *
  */
 void
@@ -2701,11 +3000,17 @@ ImageLabeler::loadImages()
 
 	QFileDialog fileDialog(0, tr("Load images"));
 	fileDialog.setFileMode(QFileDialog::Directory);
-	QString dirName("");
+	/* native dialogs can't select several folders */
+	fileDialog.setOption(QFileDialog::DontUseNativeDialog, true);
+	foreach (QAbstractItemView *view,
+		fileDialog.findChildren< QAbstractItemView * >())
+	{
+		view->setSelectionMode(QAbstractItemView::ExtendedSelection);
+	}
+	QStringList dirNames;
 
 	if (fileDialog.exec()) {
-		/* TODO: make it possible to select multiple folders */
-		dirName = fileDialog.selectedFiles().last();
+		dirNames = removeNestedDirs(fileDialog.selectedFiles());
 	}
 	else {
 		//showWarning(tr("Could not open file dialog"));
@@ -2713,115 +3018,572 @@ ImageLabeler::loadImages()
 		/* NOTREACHED */
 	}
 
+	if (dirNames.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
 	clearAllTool();
 
-	/* creating a widget with a "cancel" button to
-	 * give user an opportunity to stop the recursive search */
-	QWidget *searchInProgress = new QWidget(0);
-	searchInProgress->setWindowTitle(tr("Loading images"));
-	QLabel *info = new QLabel(searchInProgress);
-	info->setText(
+	label_search_->setText(
 		tr("Program is looking for all image files in your directory recursively."));
-	QPushButton *cancel = new QPushButton(tr("Cancel"), searchInProgress);
-	connect(cancel, SIGNAL(clicked()), this, SLOT(interruptSearch()));
-	QVBoxLayout *layout = new QVBoxLayout(searchInProgress);
-	searchInProgress->setLayout(layout);
-	layout->addWidget(info);
-	layout->addWidget(cancel);
-	searchInProgress->adjustSize();
-	searchInProgress->move(QApplication::desktop()->screen()->rect().center() - rect().center());
-	searchInProgress->show();
-
-	getImagesFromDir(QDir(dirName));
-
-	/* deleting everything related to searchInProgress widget */
-	cancel->disconnect();
-	searchInProgress->hide();
-	delete info;
-	delete cancel;
-	delete layout;
-	delete searchInProgress;
-
-	if (interrupt_search_) {
-		interrupt_search_ = 0;
+	widget_search_->adjustSize();
+	widget_search_->move(QApplication::desktop()->screen()->rect().center() - rect().center());
+	widget_search_->show();
+
+	images_found_ = 0;
+	dataset_watcher_->clear();
+	dataset_roots_ = dirNames;
+
+	foreach (ImageScanner *scanner, scanners_)
+		scanner->cancel();
+
+	/* one scanner per folder, so the latency of network storages overlaps */
+	while (scanners_.count() < dirNames.count()) {
+		ImageScanner *scanner = new ImageScanner(this);
+		connect(
+			scanner,
+			SIGNAL(imagesFound(int, const QList< Image > &)),
+			this,
+			SLOT(onImagesFound(int, const QList< Image > &))
+			);
+		connect(
+			scanner,
+			SIGNAL(searchFinished(int)),
+			this,
+			SLOT(onSearchFinished(int))
+			);
+		connect(
+			scanner,
+			SIGNAL(directoriesFound(int, const QStringList &)),
+			this,
+			SLOT(onDirectoriesFound(int, const QStringList &))
+			);
+		scanners_.append(scanner);
+	}
+
+	roots_count_ = dirNames.count();
+	current_root_ = 0;
+	pending_images_.clear();
+	roots_finished_.fill(false, roots_count_);
+	for (int i = 0; i < roots_count_; i++) {
+		pending_images_.append(QList< Image >());
+		scanners_.at(i)->setHashing(action_find_duplicates_->isChecked());
+		scanners_.at(i)->scan(dirNames.at(i));
+	}
+}
+
+//! \brief A slot member loading all the images stored in a tar or
+//! an uncompressed zip archive
+/*!
+ * The archive is indexed in the background, nothing is extracted.
+ * \see ImageArchive
+ */
+void
+ImageLabeler::loadArchive()
+{
+	if (!askForUnsavedData()) {
 		return;
 		/* NOTREACHED */
 	}
 
-	if (!list_images_widget_->count()) {
-		showWarning(tr("The folder you selected contains no images"));
+	QString filename = QFileDialog::getOpenFileName(
+		this,
+		tr("Load images from archive"),
+		QString(),
+		tr("Archives (*.tar *.zip)")
+		);
+	if (filename.isEmpty()) {
 		return;
 		/* NOTREACHED */
 	}
 
-	bool ret = 0;
-	if (list_images_->at(0).labeled_) {
-		QString labeled =
-			alterFileName(list_images_->at(0).image_, "_labeled");
-		labeled.append(".dat");
-		ret = loadInfo(labeled);
-	}
-	else
-		ret = image_->load(list_images_->at(0).image_);
+	clearAllTool();
+	dataset_roots_.clear();
 
-	if (!ret) {
+	label_search_->setText(tr("Program is indexing the archive."));
+	widget_search_->adjustSize();
+	widget_search_->move(QApplication::desktop()->screen()->rect().center() - rect().center());
+	widget_search_->show();
+	button_cancel_search_->setEnabled(false);
+
+	images_found_ = 0;
+	archive_loader_->setFuture(
+		QtConcurrent::run(ImageArchive::loadImages, filename)
+		);
+}
+
+//! \brief A slot member adding the images of the archive indexed
+//! in the background
+void
+ImageLabeler::onArchiveLoaded()
+{
+	widget_search_->hide();
+	button_cancel_search_->setEnabled(true);
+
+	QList< Image > images = archive_loader_->result();
+	if (images.isEmpty()) {
+		showWarning(tr("The archive contains no images which can be read"));
 		return;
 		/* NOTREACHED */
 	}
-	current_image_ = list_images_->at(0).image_;
-	image_ID_ = 0;
-	list_images_widget_->setCurrentRow(image_ID_);
 
-	QString winTitle;
-	winTitle.append("ImageLabeler - ");
-	winTitle.append(current_image_);
-	setWindowTitle(winTitle);
+	addFoundImages(images);
 
-	image_holder_->resize(image_->size());
-	image_holder_->setPixmap(*image_);
+	/* the archive is the dataset root, its label index is kept in the
+	 * sidecar directory(see LabelIndex::indexFile()) */
+	QString archive;
+	if (ImageArchive::splitPath(images.first().image_, &archive, 0)) {
+		QString root = ImageArchive::memberPath(archive, QString());
+		root.chop(1);
+		dataset_roots_ = QStringList(root);
+		buildLabelIndex();
+	}
 
-	enableTools();
+	if (ImageSorter::ScanOrder != imageOrder())
+		sortImages();
 }
 
-//! A slot member loading legend(labels) from xml file
+//! \brief A protected member returning the number of the folder being
+//! searched by aScanner in the current search
 /*!
- * \see loadLegendFromNode(QDomElement *anElement)
+ * \param[in] aScanner the scanner which sent the signal
+ * \param[in] aGeneration a number of the scan the signal belongs to
+ *
+ * Returns -1 if the signal belongs to one of the previous searches.
  */
-void
-ImageLabeler::loadLegendFromFile()
+int
+ImageLabeler::searchRoot(QObject *aScanner, int aGeneration) const
 {
-	QFileDialog fileDialog(0, tr("Load legend"));
-	fileDialog.setFileMode(QFileDialog::AnyFile);
-	QString filename;
-
-	if (fileDialog.exec()) {
-		filename = fileDialog.selectedFiles().last();
+	int root = scanners_.indexOf(qobject_cast< ImageScanner * >(aScanner));
+	if (root < 0 || roots_count_ <= root ||
+		aGeneration != scanners_.at(root)->generation())
+	{
+		return -1;
+		/* NOTREACHED */
 	}
-	else {
-		//showWarning(tr("Could not open file dialog"));
+
+	return root;
+}
+
+//! \brief A slot member adding the batch of images found by one of
+//! the scanners_
+/*!
+ * \param[in] aGeneration a number of the scan the batch belongs to,
+ * batches of the previous scans are ignored
+ * \param[in] anImages found images
+ *
+ * Images of the folders are added in the order the folders were selected:
+ * images of the next folders wait in pending_images_ till the previous
+ * folders are done, so the order does not depend on which storage is
+ * faster.
+ */
+void
+ImageLabeler::onImagesFound(int aGeneration, const QList< Image > &anImages)
+{
+	int root = searchRoot(sender(), aGeneration);
+	if (root < 0 || anImages.isEmpty()) {
 		return;
 		/* NOTREACHED */
 	}
 
-	QDomDocument doc("Image Labeler");
-	QFile file(filename);
-	if (!file.open(QIODevice::ReadOnly)) {
-		showWarning(tr("Can not open such file"));
+	if (root != current_root_) {
+		pending_images_[root].append(anImages);
 		return;
 		/* NOTREACHED */
 	}
 
-	QString errMsg;
-	if (!doc.setContent(&file, &errMsg)) {
-		showWarning(errMsg);
-		file.close();
+	addFoundImages(anImages);
+}
+
+//! A protected member adding the images found by the search to the list
+/*!
+ * The first image found is opened at once, so the user can start labeling
+ * while the search goes on.
+ */
+void
+ImageLabeler::addFoundImages(const QList< Image > &anImages)
+{
+	if (anImages.isEmpty()) {
 		return;
 		/* NOTREACHED */
 	}
 
-	file.close();
+	int first = list_images_->count();
+	bool openFirst = !images_found_;
 
-	list_label_->clear();
+	list_images_->append(anImages);
+	button_remove_image_->setEnabled(true);
+
+	images_found_ += anImages.count();
+	label_search_->setText(tr("%1 images found so far").arg(images_found_));
+
+	/* the first image could be hidden by the filter */
+	if (!openFirst || list_images_->count() <= first) {
+		return;
+		/* NOTREACHED */
+	}
+
+	bool ret = 0;
+	if (list_images_->isLabeled(first)) {
+		ret = loadInfo(ImageArchive::dataFile(list_images_->path(first)));
+	}
+	else
+		ret = openImageFile(list_images_->path(first));
+
+	if (!ret) {
+		return;
+		/* NOTREACHED */
+	}
+	current_image_ = list_images_->path(first);
+	image_ID_ = first;
+	setCurrentImage(image_ID_);
+
+	QString winTitle;
+	winTitle.append("ImageLabeler - ");
+	winTitle.append(current_image_);
+	setWindowTitle(winTitle);
+
+	image_holder_->resize(image_holder_->imageSize());
+
+	enableTools();
+}
+
+//! \brief A slot member being called when one of the scanners_
+//! has finished the search
+/*!
+ * \param[in] aGeneration a number of the scan which has finished,
+ * the scans cancelled by the next search are ignored
+ */
+void
+ImageLabeler::onSearchFinished(int aGeneration)
+{
+	int root = searchRoot(sender(), aGeneration);
+	if (root < 0) {
+		return;
+		/* NOTREACHED */
+	}
+	ImageScanner *scanner = scanners_.at(root);
+
+	roots_finished_[root] = true;
+
+	/* passing the images which waited for the previous folders */
+	while (current_root_ < roots_count_ && roots_finished_.at(current_root_)) {
+		current_root_++;
+		if (current_root_ < roots_count_) {
+			addFoundImages(pending_images_.at(current_root_));
+			pending_images_[current_root_].clear();
+		}
+	}
+
+	if (current_root_ < roots_count_) {
+		return;
+		/* NOTREACHED */
+	}
+
+	widget_search_->hide();
+
+	if (!images_found_ && !scanner->isCancelled())
+		showWarning(tr("The folder you selected contains no images"));
+
+	/* images missing from the list would be dropped from the index */
+	bool cancelled = 0;
+	for (int i = 0; i < roots_count_; i++)
+		cancelled = cancelled || scanners_.at(i)->isCancelled();
+	if (!cancelled)
+		buildLabelIndex();
+	if (action_find_duplicates_->isChecked())
+		findDuplicates();
+	if (ImageSorter::ScanOrder != imageOrder())
+		sortImages();
+}
+
+//! \brief A protected member updating the label_index_ of the loaded
+//! folders in the background
+/*!
+ * \see LabelIndex::build()
+ * \see onLabelIndexBuilt()
+ */
+void
+ImageLabeler::buildLabelIndex()
+{
+	QList< QList< Image > > labeled;
+	foreach (const QString &root, dataset_roots_)
+		labeled.append(list_images_->labeledImages(root));
+
+	/* the index files are written by one thread at a time */
+	label_index_saver_->waitForFinished();
+	label_index_watcher_->setProperty("generation", list_generation_);
+	label_index_watcher_->setFuture(
+		QtConcurrent::run(buildLabelIndexes, dataset_roots_, labeled)
+		);
+}
+
+//! A slot member taking the label index built in the background
+/*!
+ * The index built for the folders loaded before clearAll() is dropped.
+ */
+void
+ImageLabeler::onLabelIndexBuilt()
+{
+	if (list_generation_ !=
+		label_index_watcher_->property("generation").toInt())
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	label_index_.merge(label_index_watcher_->result());
+	updateLabelFilter();
+
+	/* the images of the label shown could have changed */
+	if (FirstLabelItem <= combo_image_filter_->currentIndex())
+		setImageFilter(combo_image_filter_->currentIndex());
+}
+
+//! \brief A slot member writing the index files of the roots where the data
+//! was saved since the last time, the files are written in the background
+/*!
+ * \see flushLabelIndex()
+ *
+ * Writing is postponed while the index is being built, the build writes
+ * the same files.
+ */
+void
+ImageLabeler::saveLabelIndex()
+{
+	if (unsaved_index_roots_.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	if (label_index_saver_->isRunning() || label_index_watcher_->isRunning()) {
+		label_index_timer_->start();
+		return;
+		/* NOTREACHED */
+	}
+
+	writeLabelIndex();
+}
+
+//! \brief A protected member starting to write the outdated index files
+//! right away, before the label_index_ is dropped
+void
+ImageLabeler::flushLabelIndex()
+{
+	label_index_timer_->stop();
+	if (unsaved_index_roots_.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	label_index_saver_->waitForFinished();
+	writeLabelIndex();
+}
+
+//! \brief A protected member writing the index files of the
+//! unsaved_index_roots_ in the worker thread
+/*!
+ * The worker writes a copy of the label_index_, so it can be changed
+ * meanwhile.
+ */
+void
+ImageLabeler::writeLabelIndex()
+{
+	label_index_saver_->setFuture(
+		QtConcurrent::run(
+			saveLabelIndexes,
+			label_index_,
+			QStringList(unsaved_index_roots_.toList())
+			)
+		);
+	unsaved_index_roots_.clear();
+}
+
+//! \brief A protected member grouping the duplicates among the loaded
+//! images in the background
+/*!
+ * Only the images hashed during the search are taken into account.
+ * \see action_find_duplicates_
+ * \see onDuplicatesFound()
+ */
+void
+ImageLabeler::findDuplicates()
+{
+	QVector< quint64 > content;
+	QVector< quint64 > perceptual;
+	list_images_->hashes(&content, &perceptual);
+
+	duplicates_watcher_->setProperty("generation", list_generation_);
+	duplicates_watcher_->setFuture(
+		QtConcurrent::run(DuplicateFinder::groups, content, perceptual, 3)
+		);
+}
+
+//! Returns the order of the image list chosen by the user
+/*!
+ * \see ImageSorter::Order
+ */
+int
+ImageLabeler::imageOrder() const
+{
+	QAction *checked = group_image_order_->checkedAction();
+	if (!checked)
+		return ImageSorter::ScanOrder;
+
+	return checked->data().toInt();
+}
+
+//! \brief A slot member sorting the image list in the order chosen by
+//! the user, the sorting is done in the background
+/*!
+ * \see ImageSorter::sort()
+ * \see onImagesSorted()
+ */
+void
+ImageLabeler::sortImages()
+{
+	sorter_->setProperty("generation", list_generation_);
+	sorter_->setFuture(
+		QtConcurrent::run(
+			ImageSorter::sort,
+			list_images_->sortColumns(),
+			imageOrder()
+			)
+		);
+}
+
+//! \brief A slot member showing the images in the order computed
+//! in the background
+/*!
+ * The current image stays current.
+ */
+void
+ImageLabeler::onImagesSorted()
+{
+	if (list_generation_ != sorter_->property("generation").toInt()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int id = list_images_->idOfRow(image_ID_);
+
+	list_images_->setOrder(sorter_->result());
+
+	image_ID_ = list_images_->rowOfId(id);
+	setCurrentImage(image_ID_);
+}
+
+//! A slot member marking the duplicates grouped in the background
+/*!
+ * Groups are made of ids, so the ones found for the list cleared since
+ * are dropped.
+ */
+void
+ImageLabeler::onDuplicatesFound()
+{
+	if (list_generation_ !=
+		duplicates_watcher_->property("generation").toInt())
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	int id = list_images_->idOfRow(image_ID_);
+
+	list_images_->setDuplicateGroups(duplicates_watcher_->result());
+
+	image_ID_ = list_images_->rowOfId(id);
+	setCurrentImage(image_ID_);
+}
+
+//! \brief A protected member filling the combo_image_filter_ with
+//! the labels from the label_index_
+/*!
+ * The label chosen stays chosen, if it has gone all the images are shown.
+ */
+void
+ImageLabeler::updateLabelFilter()
+{
+	int previous = combo_image_filter_->currentIndex();
+	QString label = combo_image_filter_->itemData(previous).toString();
+
+	combo_image_filter_->blockSignals(true);
+	combo_image_filter_->clear();
+	combo_image_filter_->addItem(tr("All images"));
+	combo_image_filter_->addItem(tr("Unlabeled images"));
+	combo_image_filter_->addItem(tr("Duplicate images"));
+	foreach (QString name, label_index_.labels()) {
+		combo_image_filter_->addItem(
+			tr("%1 (%2)").arg(name).arg(label_index_.images(name).count()),
+			name
+			);
+	}
+
+	int current = qMax(previous, int(AllImagesItem));
+	if (FirstLabelItem <= current)
+		current = qMax(combo_image_filter_->findData(label), 0);
+	combo_image_filter_->setCurrentIndex(current);
+	combo_image_filter_->blockSignals(false);
+
+	if (FirstLabelItem <= previous && AllImagesItem == current)
+		setImageFilter(current);
+}
+
+//! A protected member returning the loaded folder which contains anImage
+/*!
+ * Returns an empty string if the image was not loaded with a folder.
+ */
+QString
+ImageLabeler::datasetRoot(const QString &anImage) const
+{
+	foreach (const QString &root, dataset_roots_) {
+		if (anImage.startsWith(root + QString("/")))
+			return root;
+	}
+
+	return QString();
+}
+
+//! A slot member loading legend(labels) from xml file
+/*!
+ * \see loadLegendFromNode(QDomElement *anElement)
+ */
+void
+ImageLabeler::loadLegendFromFile()
+{
+	QFileDialog fileDialog(0, tr("Load legend"));
+	fileDialog.setFileMode(QFileDialog::AnyFile);
+	QString filename;
+
+	if (fileDialog.exec()) {
+		filename = fileDialog.selectedFiles().last();
+	}
+	else {
+		//showWarning(tr("Could not open file dialog"));
+		return;
+		/* NOTREACHED */
+	}
+
+	QDomDocument doc("Image Labeler");
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly)) {
+		showWarning(tr("Can not open such file"));
+		return;
+		/* NOTREACHED */
+	}
+
+	QString errMsg;
+	if (!doc.setContent(&file, &errMsg)) {
+		showWarning(errMsg);
+		file.close();
+		return;
+		/* NOTREACHED */
+	}
+
+	file.close();
+
+	list_label_->clear();
 
 	/* getting legend */
 	QDomElement elements = doc.documentElement();
@@ -3587,7 +4349,13 @@ ImageLabeler::clearAll()
 	list_bounding_box_.clear();
 	list_polygon_.clear();
 	list_images_->clear();
-	list_images_widget_->clear();
+	list_generation_++;
+	thumbnail_cache_->clearRequests();
+	dataset_watcher_->clear();
+	dataset_roots_.clear();
+	flushLabelIndex();
+	label_index_.clear();
+	updateLabelFilter();
 	main_label_ = -1;
 	image_holder_->clearAll();
 	segmented_image_.clear();
@@ -3758,15 +4526,15 @@ ImageLabeler::labelListPopupMenu(const QPoint &aPos)
 void
 ImageLabeler::imageListPopupMenu(const QPoint &aPos)
 {
-	QPoint globalPos = list_images_widget_->mapToGlobal(aPos);
-	QModelIndex index = list_images_widget_->indexAt(aPos);
+	QPoint globalPos = list_images_view_->mapToGlobal(aPos);
+	QModelIndex index = list_images_view_->indexAt(aPos);
 
 	if (-1 == index.row()) {
 		return;
 		/* NOTREACHED */
 	}
 
-	list_images_widget_->item(index.row())->setSelected(true);
+	list_images_view_->setCurrentIndex(index);
 
 	popup_images_list_->exec(globalPos);
 }
@@ -3804,7 +4572,7 @@ ImageLabeler::setPureData()
 	}
 
 	/* getting image size */
-	QSize imageSize = image_->size();
+	QSize imageSize = image_holder_->imageSize();
 	pure_data_ = new int *[imageSize.height()];
 	if (!pure_data_) {
 		return;
@@ -3819,28 +4587,52 @@ ImageLabeler::setPureData()
 		}
 	}
 
-	/* getting the number of all selections */
-	int bboxCnt = list_bounding_box_.count();
-	int polyCnt = list_polygon_.count();
-	/* checking if each coordinate(pixel) belongs to any object */
+	QVector< QRect > polyRects = polygonRects();
 	for (int i = 0; i < imageSize.height(); i++)
-		for (int j = 0; j < imageSize.width(); j++) {
-			pure_data_[i][j] = 0;
-			/* bboxes first */
-			for (int cnt = 0; cnt < bboxCnt; cnt++) {
-				BoundingBox *bbox = list_bounding_box_.at(cnt);
-				if (bbox->rect.contains(j, i)) {
-					pure_data_[i][j] = bbox->label_ID_;
-				}
-			}
-			/* polys next */
-			for (int cnt = 0; cnt < polyCnt; cnt++) {
-				Polygon *poly = list_polygon_.at(cnt);
-				if (poly->poly.containsPoint(QPoint(j, i), Qt::OddEvenFill)) {
-					pure_data_[i][j] = poly->label_ID_;
-				}
-			}
-		}
+		labelRow(i, imageSize.width(), polyRects, pure_data_[i]);
+}
+
+//! \brief A protected member returning the bounding rects of the
+//! list_polygon_ for labelRow()
+QVector< QRect >
+ImageLabeler::polygonRects() const
+{
+	QVector< QRect > rects;
+	rects.reserve(list_polygon_.count());
+	for (int i = 0; i < list_polygon_.count(); i++)
+		rects.append(list_polygon_.at(i)->poly.boundingRect());
+
+	return rects;
+}
+
+//! A protected member rasterizing one row of the segmented image
+/*!
+ * \see setPureData()
+ * \param[in] aRow a number of the row
+ * \param[in] aWidth a width of the image
+ * \param[in] aPolyRects bounding rects of the polygons(see polygonRects())
+ * \param[out] aLabels an array of aWidth elements receiving label ids
+ *
+ * The image can be rasterized row by row without allocating the whole
+ * array. The overlay of ImageHolder uses the same rasterizeRow().
+ */
+void
+ImageLabeler::labelRow(
+	int aRow,
+	int aWidth,
+	const QVector< QRect > &aPolyRects,
+	int *aLabels
+) const
+{
+	rasterizeRow(
+		aRow,
+		0,
+		aWidth - 1,
+		list_bounding_box_,
+		list_polygon_,
+		aPolyRects,
+		aLabels
+		);
 }
 
 //! \brief A slot member setting new color for
@@ -3924,8 +4716,7 @@ ImageLabeler::viewNormal()
 		/* NOTREACHED */
 	}
 
-	image_->load(current_image_);
-	image_holder_->setPixmap(*image_);
+	openImageFile(current_image_);
 
 	action_view_segmented_->setEnabled(true);
 	action_view_normal_->setEnabled(false);
@@ -3943,36 +4734,138 @@ ImageLabeler::viewSegmented()
 		/* NOTREACHED */
 	}
 
-	image_->load(segmented_image_);
-	image_holder_->setPixmap(*image_);
+	openImageFile(segmented_image_);
 
 	action_view_segmented_->setEnabled(false);
 	action_view_normal_->setEnabled(true);
 }
 
-//! \brief A slot member setting interrupt_search_ to true for interrupting
-//! the recursive search
+//! \brief A slot member passing the directories found by the scanners_
+//! to the dataset_watcher_
+void
+ImageLabeler::onDirectoriesFound(int aGeneration, const QStringList &aDirs)
+{
+	if (searchRoot(sender(), aGeneration) < 0) {
+		return;
+		/* NOTREACHED */
+	}
+
+	dataset_watcher_->addDirectories(aDirs);
+}
+
+//! \brief A slot member bringing the list of images in line with
+//! the changed directory
+/*!
+ * \param[in] aDir an absolute path to the directory
+ * \param[in] anImages all the images aDir contains now
+ *
+ * Removed images are removed from the list(except the one which is open),
+ * new ones are added to the end of it, labeled flags and the label_index_
+ * are updated.
+ *
+ * \see DatasetWatcher
+ */
+void
+ImageLabeler::onDirectoryUpdated(
+	const QString &aDir,
+	const QList< Image > &anImages
+)
+{
+	QHash< QString, int > fresh;
+	fresh.reserve(anImages.count());
+	for (int i = 0; i < anImages.count(); i++)
+		fresh.insert(anImages.at(i).image_, i);
+
+	bool labelsChanged = 0;
+	QList< int > ids = list_images_->idsInDirectory(aDir);
+	for (int i = ids.count() - 1; 0 <= i; i--) {
+		int id = ids.at(i);
+		Image image = list_images_->imageById(id);
+		if (image.pas_) {
+			continue;
+		}
+
+		if (!fresh.contains(image.image_)) {
+			int row = list_images_->rowOfId(id);
+			if (row < 0)
+				list_images_->removeById(id);
+			else if (row != image_ID_)
+				removeImage(row);
+			else
+				continue;
+
+			labelsChanged = labelsChanged || label_index_.contains(image.image_);
+			label_index_.removeImage(image.image_);
+			continue;
+		}
+
+		Image update = anImages.at(fresh.take(image.image_));
+		if (update.labeled_ == image.labeled_ &&
+			update.annotation_ == image.annotation_)
+		{
+			continue;
+		}
+
+		/* the watcher does not hash the images */
+		if (update.bytes_ == image.bytes_ &&
+			update.modified_ == image.modified_)
+		{
+			update.content_hash_ = image.content_hash_;
+			update.perceptual_hash_ = image.perceptual_hash_;
+		}
+
+		list_images_->setImageById(id, update);
+
+		labelsChanged = 1;
+		if (update.labeled_) {
+			label_index_.setImage(
+				update.image_,
+				LabelIndex::indexDataFile(ImageArchive::dataFile(update.image_))
+				);
+		}
+		else
+			label_index_.removeImage(update.image_);
+	}
+
+	if (labelsChanged)
+		updateLabelFilter();
+
+	/* whatever is left is new */
+	QList< int > added = fresh.values();
+	qSort(added);
+	QList< Image > newImages;
+	foreach (int i, added)
+		newImages.append(anImages.at(i));
+	if (!newImages.isEmpty()) {
+		list_images_->append(newImages);
+		button_remove_image_->setEnabled(true);
+	}
+}
+
+//! \brief A slot member interrupting the recursive search,
+//! images found so far stay in the list
 /*!
  * \see loadImages()
- * \see getImagesFromDir(const QDir &dir)
+ * \see ImageScanner::cancel()
  */
 void
 ImageLabeler::interruptSearch()
 {
-	interrupt_search_ = 1;
+	foreach (ImageScanner *scanner, scanners_)
+		scanner->cancel();
 }
 
-//! \brief A slot member selecting image corresponding to the item
-//! in the list_images_widget_
+//! \brief A slot member selecting image corresponding to the index
+//! in the list_images_view_
 /*!
  * \see selectImage(int anImageID)
- * \param[in] anItem a pointer to the QListWidgetItem object which indicates
- * certain image in the image_list_
+ * \param[in] anIndex an index in the list_images_ which indicates
+ * certain image
  */
 void
-ImageLabeler::selectImage(QListWidgetItem *anItem)
+ImageLabeler::selectImage(const QModelIndex &anIndex)
 {
-	if (!anItem || list_images_widget_->row(anItem) < 0 ||
+	if (!anIndex.isValid() || anIndex.row() < 0 ||
 		list_images_->isEmpty())
 	{
 		return;
@@ -3982,11 +4875,58 @@ ImageLabeler::selectImage(QListWidgetItem *anItem)
 	//clearLabelList();
 	//clearLabelColorList();
 
-	image_ID_ = list_images_widget_->row(anItem);
+	image_ID_ = anIndex.row();
 
 	selectImage(image_ID_);
 }
 
+//! A slot member showing only the images chosen in the combo_image_filter_
+/*!
+ * \param[in] anIndex an item of the combo_image_filter_: all the images,
+ * unlabeled images, duplicates or the images containing the label of
+ * the item(see label_index_)
+ *
+ * The current image stays current if it passes the filter.
+ */
+void
+ImageLabeler::setImageFilter(int anIndex)
+{
+	int id = list_images_->idOfRow(image_ID_);
+
+	if (anIndex <= AllImagesItem) {
+		list_images_->setFilter(ImageListModel::AllImages);
+	}
+	else if (UnlabeledImagesItem == anIndex) {
+		list_images_->setFilter(ImageListModel::UnlabeledImages);
+	}
+	/* the groups are brought up to date in the background */
+	else if (DuplicateImagesItem == anIndex) {
+		list_images_->setFilter(ImageListModel::DuplicateImages);
+		findDuplicates();
+	}
+	else {
+		QString label = combo_image_filter_->itemData(anIndex).toString();
+		list_images_->setFilter(
+			ImageListModel::SelectedImages,
+			label_index_.images(label)
+			);
+	}
+
+	image_ID_ = list_images_->rowOfId(id);
+	setCurrentImage(image_ID_);
+	button_remove_image_->setEnabled(!list_images_->isEmpty());
+}
+
+//! A protected member making the image current in the list_images_view_
+/*!
+ * \param[in] anImageID a number of the image in the list_images_
+ */
+void
+ImageLabeler::setCurrentImage(int anImageID)
+{
+	list_images_view_->setCurrentIndex(list_images_->index(anImageID));
+}
+
 //! A protected member loading image from list_images_
 /*!
  * \see loadInfo(QString filename)
@@ -4009,29 +4949,25 @@ ImageLabeler::selectImage(int anImageID)
 	action_view_segmented_->setEnabled(false);
 
 	/* checking if it was labeled before */
-	if (list_images_->at(anImageID).labeled_ &&
-		!list_images_->at(anImageID).pas_)
+	if (list_images_->isLabeled(anImageID) &&
+		!list_images_->isPascal(anImageID))
 	{
 		list_label_colors_.clear();
 		list_label_->clear();
-		QString labeled =
-			alterFileName(list_images_->at(anImageID).image_, "_labeled");
-		labeled.append(".dat");
-		loadInfo(labeled);
+		loadInfo(ImageArchive::dataFile(list_images_->path(anImageID)));
 	}
 	/* if it was loaded from PASCAL file then we're in trouble */
-	else if (list_images_->at(anImageID).labeled_ &&
-		list_images_->at(anImageID).pas_)
+	else if (list_images_->isLabeled(anImageID) &&
+		list_images_->isPascal(anImageID))
 	{
 		/* TODO: do the pascal file selecting */
 		showWarning("this function doesn't work at the moment, sorry.");
 	}
 	/* loading clean unlabeled image */
 	else {
-		current_image_ = list_images_->at(anImageID).image_;
-		image_->load(current_image_);
-		image_holder_->setPixmap(*image_);
-		image_holder_->resize(image_->size());
+		current_image_ = list_images_->path(anImageID);
+		openImageFile(current_image_);
+		image_holder_->resize(image_holder_->imageSize());
 	}
 
 	return true;
@@ -4048,55 +4984,188 @@ ImageLabeler::selectImage(int anImageID)
 void
 ImageLabeler::removeImage()
 {
-	int imageCount = list_images_widget_->count();
-	int num = list_images_widget_->currentRow();
+	removeImage(list_images_view_->currentIndex().row());
+}
 
-	if (!imageCount || num < 0 || imageCount <= num ||
-		list_images_->count() != imageCount)
-	{
+//! A protected member removing the image from the list
+/*!
+ * \param[in] anImageID a number of the image in the list_images_
+ */
+void
+ImageLabeler::removeImage(int anImageID)
+{
+	int imageCount = list_images_->count();
+	int num = anImageID;
+
+	if (!imageCount || num < 0 || imageCount <= num) {
 		return;
 		/* NOTREACHED */
 	}
 
-	list_images_widget_->takeItem(num);
-	list_images_->takeAt(num);
+	/* the model looks up the rows of the following images again
+	 * only when they are asked for */
+	list_images_->remove(num);
 
-	for (int i = num ; i < list_images_widget_->count(); i++) {
-		QString newStr = removePath(list_images_->at(i).image_);
-		newStr.prepend(QString("%1: ").arg(i));
-		list_images_widget_->item(i)->setText(newStr);
-	}
+	if (num < image_ID_)
+		image_ID_--;
 
 	if (1 == imageCount)
 		button_remove_image_->setEnabled(false);
 }
 
-//!
+//! A protected member loading an image and fitting it into image_holder_
+/*!
+ * \param[in] aPath a path to the image
+ *
+ * The image is zoomed out with the same 1.1 step the wheel zoom uses
+ * until it fits into the current size of image_holder_
+ */
 bool
 ImageLabeler::loadPixmap(const QString &aPath)
 {
-	if (!image_->load(aPath)) {
+	if (!openImageFile(aPath)) {
 		return false;
 		/* NOTREACHED */
 	}
 
 	QSize holderSize = image_holder_->size();
-	QSize imageSize = image_->size();
+	QSize imageSize = image_holder_->imageSize();
 	double scale = 1;
 
-	while (holderSize.width() * scale < imageSize.width() ||
-		holderSize.height() * scale < imageSize.height())
-	{
-		scale *= 1.1;
+	/* the smallest power of 1.1 which makes the image fit */
+	if (!holderSize.isEmpty()) {
+		double ratio = qMax(
+			double(imageSize.width()) / holderSize.width(),
+			double(imageSize.height()) / holderSize.height()
+			);
+		if (1 < ratio)
+			scale = qPow(1.1, qCeil(qLn(ratio) / qLn(1.1)));
 	}
 
 	image_holder_->resize(imageSize);
-	image_holder_->setPixmap(*image_);
 	image_holder_->scaleImage(ZoomOut, scale);
 
 	return true;
 }
 
+//! A protected member loading an image and giving it to image_holder_
+/*!
+ * \param[in] aPath a path to the image
+ *
+ * Images which are too big to be kept in memory(see TiledImageSource::isHuge)
+ * are not loaded into image_, image_holder_ decodes only the tiles it draws.
+ *
+ * If the decoder can scale during decoding(jpeg), a reduced preview is
+ * decoded first and shown at once, the full resolution is decoded in the
+ * background and replaces it in onImageLoaded(). Size of the image is known
+ * from the header, so selections keep original coordinates all the time.
+ *
+ * This member does not resize image_holder_.
+ */
+bool
+ImageLabeler::openImageFile(const QString &aPath)
+{
+	/* result of the previous background decoding is not needed anymore */
+	loading_image_.clear();
+
+	TiledImageSource source(aPath);
+	if (source.isValid() &&
+		source.supportsRegions() &&
+		TiledImageSource::isHuge(source.size()))
+	{
+		*image_ = QImage();
+		image_holder_->setImageSource(source);
+		return true;
+		/* NOTREACHED */
+	}
+
+	/* looking for the pyramid level which fits 2048x2048 */
+	int previewLevel = 0;
+	QSize previewSize = source.size();
+	while (source.isValid() &&
+		(2048 < previewSize.width() || 2048 < previewSize.height()))
+	{
+		previewLevel++;
+		previewSize = ImagePyramid::halvedSize(source.size(), previewLevel);
+	}
+
+	if (previewLevel && source.supportsScaling()) {
+		QImage preview = source.decode(
+			QRect(QPoint(0, 0), source.size()),
+			previewSize
+			);
+
+		if (!preview.isNull()) {
+			*image_ = QImage();
+			image_holder_->setPreview(source.size(), previewLevel, preview);
+
+			loading_image_ = aPath;
+			image_loader_->setFuture(QtConcurrent::run(readImage, aPath));
+			return true;
+			/* NOTREACHED */
+		}
+	}
+
+	ArchiveImageReader reader(aPath);
+	QImage image = reader.read();
+	if (image.isNull()) {
+		return false;
+		/* NOTREACHED */
+	}
+	*image_ = image;
+
+	image_holder_->reloadImage();
+	return true;
+}
+
+//! \brief A slot member being called when the background decoding
+//! of the image started by openImageFile(const QString &aPath) is over
+/*!
+ * Replaces the preview with the full resolution image, if the user has not
+ * switched to another image yet.
+ */
+void
+ImageLabeler::onImageLoaded()
+{
+	if (loading_image_.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QImage image = image_loader_->result();
+	if (image.isNull()) {
+		showWarning(tr("Can not load image %1").arg(loading_image_));
+		loading_image_.clear();
+		return;
+		/* NOTREACHED */
+	}
+
+	loading_image_.clear();
+	*image_ = image;
+	image_holder_->reloadImage();
+}
+
+//! A slot member showing or hiding thumbnails in the list_images_view_
+/*!
+ * \param[in] aVisible whether thumbnails should be shown
+ *
+ * Thumbnails are requested only for the rows the view paints.
+ *
+ * \see ImageListModel::data()
+ */
+void
+ImageLabeler::setThumbnailsVisible(bool aVisible)
+{
+	if (aVisible) {
+		int size = thumbnail_cache_->thumbnailSize();
+		list_images_view_->setIconSize(QSize(size, size));
+	}
+	else
+		list_images_view_->setIconSize(QSize());
+
+	list_images_->setThumbnailsVisible(aVisible);
+}
+
 //! A protected member which is being automatically called on every image resize
 /*!
  *
@@ -4137,6 +5206,7 @@ ImageLabeler::mousePressEvent(QMouseEvent *anEvent)
  * - esc - clear current selection
  * - ctrl+z - image_holder_->undo()
  * - ctrl+y - iamge_holder_->redo()
+ * - F12 - show/hide the measurements of painting, hit-testing and caches
  */
 void
 ImageLabeler::keyPressEvent(QKeyEvent *anEvent)
@@ -4197,7 +5267,7 @@ ImageLabeler::keyPressEvent(QKeyEvent *anEvent)
 	}
 
 	if (Qt::Key_Delete == anEvent->key() &&
-		list_images_widget_->hasFocus()) {
+		list_images_view_->hasFocus()) {
 		removeImage();
 	}
 
@@ -4206,6 +5276,10 @@ ImageLabeler::keyPressEvent(QKeyEvent *anEvent)
 		image_holder_->removeSelectedPoint();
 	}
 
+	if (Qt::Key_F12 == anEvent->key()) {
+		image_holder_->setHudVisible(!image_holder_->isHudVisible());
+	}
+
 	QWidget::keyPressEvent(anEvent);
 }
 
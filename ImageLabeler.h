@@ -9,11 +9,20 @@
 #define __IMAGELABELER_H__
 
 #include "ImageHolder.h"
+#include "ThumbnailCache.h"
+#include "ImageScanner.h"
+#include "DatasetWatcher.h"
+#include "ImageListModel.h"
+#include "LabelIndex.h"
 #include "LineEditForm.h"
 #include "OptionsForm.h"
 
 #include <QMainWindow>
 #include <QDir>
+#include <QImage>
+#include <QFutureWatcher>
+#include <QVector>
+#include <QSet>
 
 /* forward declarations */
 class QMenuBar;
@@ -24,30 +33,21 @@ class QVBoxLayout;
 class QGridLayout;
 class QPushButton;
 class QPixmap;
+class QImage;
 class QLabel;
 class QScrollArea;
 class QFrame;
 class QListWidget;
 class QListWidgetItem;
+class QListView;
+class QActionGroup;
+class QComboBox;
+class QModelIndex;
 class QButtonGroup;
 class QDomDocument;
 class QDomElement;
 class QSettings;
-
-//! Structure keeps path to the image and it's flags
-/*
- * \see loadInfo(QString filename)
- * \see loadPascalFile(QString aFilename, QString aPath)
- *
- * Image could be labeled before so you can load all the info about it
- * using loadInfo(QString filename)
- * pas_ means it was loaded from the file with PASCAL format
- */
-struct Image {
-	QString image_;
-	bool labeled_;
-	bool pas_;
-};
+class QTimer;
 
 //! \brief Main widget which contains all GUI elements
 //! and connect them with each other.
@@ -68,9 +68,9 @@ protected:
 	void closeEvent(QCloseEvent *anEvent);
 
 	bool loadPixmap(const QString &aPath);
+	bool openImageFile(const QString &aPath);
 	bool readSettings(QSettings *aSettings);
 	bool writeSettings(QSettings *aSettings);
-	void getImagesFromDir(const QDir &dir);
 	void showWarning(const QString &text);
 	bool askForUnsavedData();
 	void loadLegendFromNode(QDomElement *anElement);
@@ -120,11 +120,29 @@ protected:
 	void legendToXml(QDomDocument *aDoc, QDomElement *aRoot);
 	void objectsToXml(QDomDocument *aDoc, QDomElement *aRoot);
 	void addImage(Image *anImage);
+	void addFoundImages(const QList< Image > &anImages);
+	void buildLabelIndex();
+	void flushLabelIndex();
+	void writeLabelIndex();
+	void findDuplicates();
+	int imageOrder() const;
+	void updateLabelFilter();
+	QString datasetRoot(const QString &anImage) const;
+	int searchRoot(QObject *aScanner, int aGeneration) const;
+	void removeImage(int anImageID);
+	void setCurrentImage(int anImageID);
 	bool loadInfo(QString filename);
 	bool loadPascalFile(QString aFilename, QString aPath = QString());
 	bool loadPascalPolys(QString aFilename);
 	bool selectImage(int anImageID);
 	void setLabelColor(int anID, QColor aColor);
+	QVector< QRect > polygonRects() const;
+	void labelRow(
+		int aRow,
+		int aWidth,
+		const QVector< QRect > &aPolyRects,
+		int *aLabels
+		) const;
 
 public:
 	ImageLabeler(QWidget *aParent = 0, QString aSettingsPath = QString());
@@ -147,6 +165,8 @@ public slots:
 	void saveLegend();
 	void loadImage();
 	void loadImages();
+	void loadArchive();
+	void onArchiveLoaded();
 	void loadInfo();
 	void loadPascalFile();
 	void loadPascalPolys();
@@ -173,10 +193,25 @@ public slots:
 	void viewNormal();
 	void viewSegmented();
 	void interruptSearch();
-	void selectImage(QListWidgetItem *);
+	void onImagesFound(int aGeneration, const QList< Image > &anImages);
+	void onSearchFinished(int aGeneration);
+	void onDirectoriesFound(int aGeneration, const QStringList &aDirs);
+	void onDirectoryUpdated(
+		const QString &aDir,
+		const QList< Image > &anImages
+		);
+	void selectImage(const QModelIndex &anIndex);
 	void removeImage();
 	void writeSettings();
 	void readSettings();
+	void onImageLoaded();
+	void setThumbnailsVisible(bool aVisible);
+	void setImageFilter(int anIndex);
+	void onLabelIndexBuilt();
+	void saveLabelIndex();
+	void onDuplicatesFound();
+	void sortImages();
+	void onImagesSorted();
 
 private:
 	/*
@@ -203,6 +238,10 @@ private:
 	//! \see action_view_normal_ \see action_view_segmented_
 	QMenu *menu_view_;
 
+	//! \brief contains the orders of the image list
+	//! \see group_image_order_
+	QMenu *menu_sort_;
+
 	/*! \brief contains tools, undo, redo, description adding and options
 	 * \see action_undo_
 	 * \see action_redo_
@@ -221,6 +260,9 @@ private:
 	//! \see loadImages()
 	QAction *action_open_images_;
 
+	//! \see loadArchive()
+	QAction *action_open_archive_;
+
 	//! \see loadImage()
 	QAction *action_open_image_;
 
@@ -256,6 +298,27 @@ private:
 	//! loads an image from segmented_image_ \see viewSegmented()
 	QAction *action_view_segmented_;
 
+	//! \brief shows thumbnails in the list_images_view_
+	//! \see setThumbnailsVisible(bool aVisible)
+	QAction *action_view_thumbnails_;
+
+	//! \brief watches loaded folders for new and labeled images
+	//! \see DatasetWatcher
+	QAction *action_watch_folders_;
+
+	//! \brief hashes the images during the search to find duplicates
+	//! \see DuplicateFinder
+	QAction *action_find_duplicates_;
+
+	//! \brief shows the labels of the pixels over the image
+	//! \see ImageHolder::setSegmentationVisible(bool aVisible)
+	QAction *action_segmentation_overlay_;
+
+	//! \brief orders of the image list, data of the actions are
+	//! ImageSorter::Order values
+	//! \see sortImages()
+	QActionGroup *group_image_order_;
+
 	/* menu edit */
 	//! \see ImageHolder::undo()
 	QAction *action_undo_;
@@ -351,11 +414,20 @@ private:
 
 	//! \brief object containing current loaded image
 	//! \see image_holder_
-	QPixmap *image_;
+	QImage *image_;
 
 	//! widget containing the image_(inherited from QLabel)
 	ImageHolder *image_holder_;
 
+	//! \brief decodes the full resolution image in the background
+	//! \see openImageFile(const QString &aPath)
+	QFutureWatcher< QImage > *image_loader_;
+
+	//! \brief path to the image being decoded by image_loader_,
+	//! empty if its result is not needed
+	//! \see onImageLoaded()
+	QString loading_image_;
+
 	//! just an information label
 	QLabel *label_toolbox_;
 
@@ -374,9 +446,93 @@ private:
 	//! list widget containing selected areas data
 	QListWidget *list_areas_;
 
-	//! \brief list widget containing loaded images names
+	//! \brief list view showing loaded images names
 	//! \see list_images_
-	QListWidget *list_images_widget_;
+	QListView *list_images_view_;
+
+	//! \brief chooses which images are shown in the list_images_view_
+	//! \see setImageFilter(int anIndex)
+	QComboBox *combo_image_filter_;
+
+	//! \brief thumbnails of the images shown in the list_images_view_
+	//! \see setThumbnailsVisible(bool aVisible)
+	ThumbnailCache *thumbnail_cache_;
+
+	//! \brief look for the images in the background, one per selected folder
+	//! \see loadImages()
+	QList< ImageScanner * > scanners_;
+
+	//! number of scanners_ used by the current search
+	int roots_count_;
+
+	//! \brief number of the folder whose images go to the list right now
+	//! \see onImagesFound(int aGeneration, const QList< Image > &anImages)
+	int current_root_;
+
+	//! images of the folders waiting for the previous folders to be done
+	QList< QList< Image > > pending_images_;
+
+	//! whether the scanner of the folder has finished
+	QVector< bool > roots_finished_;
+
+	//! \brief window with a "cancel" button shown during the search
+	//! \see interruptSearch()
+	QWidget *widget_search_;
+
+	//! shows the progress of the search
+	QLabel *label_search_;
+
+	//! \see interruptSearch()
+	QPushButton *button_cancel_search_;
+
+	//! number of images found by the current search
+	int images_found_;
+
+	//! \brief folders selected by the user for the current search or
+	//! "archive.tar!" for the loaded archive
+	//! \see LabelIndex::indexFile(const QString &aRoot)
+	QStringList dataset_roots_;
+
+	//! \brief labels of all the labeled images, images are filtered by it
+	//! \see setImageFilter(int anIndex)
+	LabelIndex label_index_;
+
+	//! \brief watches the label_index_ being built in the worker thread
+	//! \see buildLabelIndex()
+	QFutureWatcher< LabelIndex > *label_index_watcher_;
+
+	//! \brief roots whose index files are outdated
+	//! \see saveLabelIndex()
+	QSet< QString > unsaved_index_roots_;
+
+	//! \brief delays writing the index files, so saving the data several
+	//! times in a row writes them once
+	QTimer *label_index_timer_;
+
+	//! \brief watches the index files being written in the worker thread
+	//! \see saveLabelIndex()
+	QFutureWatcher< void > *label_index_saver_;
+
+	//! \brief watches the duplicates being grouped in the worker thread
+	//! \see findDuplicates()
+	QFutureWatcher< QList< QVector< int > > > *duplicates_watcher_;
+
+	//! \brief watches the archive being indexed in the worker thread
+	//! \see loadArchive()
+	QFutureWatcher< QList< Image > > *archive_loader_;
+
+	//! \brief watches the images being sorted in the worker thread
+	//! \see sortImages()
+	QFutureWatcher< QVector< int > > *sorter_;
+
+	//! \brief incremented every time the list of images is cleared,
+	//! so the order, the label index and the duplicates computed for
+	//! the previous list are dropped
+	int list_generation_;
+
+	//! \brief keeps the list of images up to date with the loaded folders
+	//! \see onDirectoryUpdated()
+	DatasetWatcher *dataset_watcher_;
 
 	//! \brief widget for editing tags and image description
 	//! \see tags_
@@ -499,7 +655,7 @@ private:
 	QList< Polygon * > list_polygon_;
 
 	//! contains the paths for all loaded images
-	QList< Image > *list_images_;
+	ImageListModel *list_images_;
 
 	//! list of label colors
 	QList< uint > list_label_colors_;
@@ -513,12 +669,6 @@ private:
 	bool auto_color_generation_;
 
 	/* flags */
-	//! \brief flag used to interrupt recursive search of the images
-	//! \see interruptSearch()
-	//! \see loadImages()
-	//! \see getImagesFromDir(const QDir &dir)
-	bool interrupt_search_;
-
 	//! flag indicating whether there is an unsaved data or not
 	bool unsaved_data_;
 
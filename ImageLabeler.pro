@@ -7,12 +7,37 @@ QT += core \
 HEADERS += LineEditForm.h \
     OptionsForm.h \
     functions.h \
+    Figures.h \
     ImageHolder.h \
+    ImagePyramid.h \
+    TiledImageSource.h \
+    ThumbnailCache.h \
+    ImageScanner.h \
+    DatasetManifest.h \
+    DatasetWatcher.h \
+    ImageListModel.h \
+    DuplicateFinder.h \
+    ImageArchive.h \
+    ImageSorter.h \
+    Instrumentation.h \
+    LabelIndex.h \
     ImageLabeler.h
 SOURCES += LineEditForm.cpp \
     OptionsForm.cpp \
     functions.cpp \
     ImageHolder.cpp \
+    ImagePyramid.cpp \
+    TiledImageSource.cpp \
+    ThumbnailCache.cpp \
+    ImageScanner.cpp \
+    DatasetManifest.cpp \
+    DatasetWatcher.cpp \
+    ImageListModel.cpp \
+    DuplicateFinder.cpp \
+    ImageArchive.cpp \
+    ImageSorter.cpp \
+    Instrumentation.cpp \
+    LabelIndex.cpp \
     ImageLabeler.cpp \
     main.cpp
 FORMS += 
@@ -0,0 +1,692 @@
+/*
+ * ImageListModel.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ImageListModel.h"
+#include "ThumbnailCache.h"
+#include "TiledImageSource.h"
+#include "ImageSorter.h"
+
+#include <QColor>
+#include <QDebug>
+
+/* ThumbnailCache keeps even fewer requests */
+static const int maxWaitingThumbnails = 1024;
+
+//! Returns flag bits for anImage
+static quint8
+imageFlags(const Image &anImage)
+{
+	quint8 flags = 0;
+	if (anImage.labeled_)
+		flags |= ImageListModel::Labeled;
+	if (anImage.pas_)
+		flags |= ImageListModel::Pascal;
+	if (TiledImageSource::isHuge(anImage.size_))
+		flags |= ImageListModel::Huge;
+
+	return flags;
+}
+
+//! A constructor of the empty model
+ImageListModel::ImageListModel(QObject *aParent)
+	: QAbstractListModel(aParent)
+{
+	filter_ = AllImages;
+	indexed_rows_ = 0;
+	thumbnail_cache_ = 0;
+	thumbnails_visible_ = 0;
+}
+
+//! An empty destructor
+ImageListModel::~ImageListModel()
+{
+
+}
+
+//! Returns the number of images shown
+int
+ImageListModel::rowCount(const QModelIndex &aParent) const
+{
+	if (aParent.isValid())
+		return 0;
+
+	return rows_.count();
+}
+
+//! Returns the data of the image for the view
+/*!
+ * Text looks like "number: file name #labeled #pas #huge", images which can
+ * not be loaded as a whole are marked with #huge and a color before anyone
+ * tries to open them. Thumbnails are requested for the rows the view asks
+ * for, that is only for the visible ones.
+ */
+QVariant
+ImageListModel::data(const QModelIndex &anIndex, int aRole) const
+{
+	int row = anIndex.row();
+	if (!anIndex.isValid() || row < 0 || count() <= row) {
+		return QVariant();
+		/* NOTREACHED */
+	}
+
+	int id = rows_.at(row);
+
+	switch (aRole) {
+	case Qt::DisplayRole:
+	{
+		QString itemText = QString("%1: %2").
+			arg(row).
+			arg(fileName(row));
+		if (flags_.at(id) & Labeled)
+			itemText.append(" #labeled");
+		if (flags_.at(id) & Pascal)
+			itemText.append(" #pas");
+		if (flags_.at(id) & Huge)
+			itemText.append(" #huge");
+		if (0 <= group_.at(id))
+			itemText.append(QString(" #dup%1").arg(group_.at(id) + 1));
+		return itemText;
+	}
+	case Qt::ToolTipRole:
+		if (!size_.at(id).isValid())
+			return pathById(id);
+		return tr("%1\n%2x%3, %4 KB").
+			arg(pathById(id)).
+			arg(size_.at(id).width()).
+			arg(size_.at(id).height()).
+			arg(bytes_.at(id) / 1024);
+	case Qt::ForegroundRole:
+		if (flags_.at(id) & Huge)
+			return QColor(Qt::darkRed);
+		return QVariant();
+	case Qt::DecorationRole:
+	{
+		if (!thumbnails_visible_ || !thumbnail_cache_)
+			return QVariant();
+		QString path = pathById(id);
+		QImage thumbnail = thumbnail_cache_->thumbnail(
+			path,
+			bytes_.at(id),
+			modified_.at(id)
+			);
+		if (thumbnail.isNull()) {
+			/* the cache serves only the latest requests anyway */
+			if (maxWaitingThumbnails <= waiting_thumbnails_.count())
+				waiting_thumbnails_.clear();
+			waiting_thumbnails_.insert(path, id);
+			return thumbnail_placeholder_;
+		}
+		return QPixmap::fromImage(thumbnail);
+	}
+	default:
+		return QVariant();
+	}
+}
+
+//! Returns the number of images shown
+int
+ImageListModel::count() const
+{
+	return rows_.count();
+}
+
+//! Returns true if no images are shown
+bool
+ImageListModel::isEmpty() const
+{
+	return rows_.isEmpty();
+}
+
+//! Adds the image to the end of the list
+void
+ImageListModel::append(const Image &anImage)
+{
+	QList< Image > images;
+	images.append(anImage);
+	append(images);
+}
+
+//! Adds all the images to the end of the list at once
+/*!
+ * Only the images passing the filter are shown.
+ */
+void
+ImageListModel::append(const QList< Image > &anImages)
+{
+	if (anImages.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int firstId = directory_.count();
+	foreach (const Image &image, anImages)
+		store(image);
+
+	QVector< int > shown;
+	for (int id = firstId; id < directory_.count(); id++) {
+		if (accepts(id))
+			shown.append(id);
+	}
+
+	if (shown.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	beginInsertRows(QModelIndex(), count(), count() + shown.count() - 1);
+	rows_ += shown;
+	indexRows(count() - shown.count());
+	endInsertRows();
+}
+
+//! Removes the shown image from the list
+void
+ImageListModel::remove(int aRow)
+{
+	if (aRow < 0 || count() <= aRow) {
+		return;
+		/* NOTREACHED */
+	}
+
+	removeById(rows_.at(aRow));
+}
+
+//! Removes the image from the list whether it is shown or not
+/*!
+ * The columns are not shrunk, the image is just marked as removed,
+ * so ids of the rest of images stay the same. Rows of the following
+ * images are looked up again only when they are asked for.
+ */
+void
+ImageListModel::removeById(int anId)
+{
+	if (anId < 0 || directory_.count() <= anId || flags_.at(anId) & Removed) {
+		return;
+		/* NOTREACHED */
+	}
+
+	flags_[anId] |= Removed;
+
+	int row = rowOfId(anId);
+	if (row < 0) {
+		return;
+		/* NOTREACHED */
+	}
+
+	beginRemoveRows(QModelIndex(), row, row);
+	rows_.remove(row);
+	row_of_id_[anId] = -1;
+	indexed_rows_ = qMin(indexed_rows_, row);
+	endRemoveRows();
+
+	/* numbers shown in all the following rows have changed, the view
+	 * repaints only the visible ones */
+	if (row < count())
+		emit dataChanged(index(row), index(count() - 1));
+}
+
+//! Removes all the images
+void
+ImageListModel::clear()
+{
+	beginResetModel();
+	rows_.clear();
+	row_of_id_.clear();
+	indexed_rows_ = 0;
+	order_.clear();
+	waiting_thumbnails_.clear();
+	directories_.clear();
+	directory_ids_.clear();
+	directory_.clear();
+	names_.clear();
+	name_offset_.clear();
+	name_length_.clear();
+	flags_.clear();
+	size_.clear();
+	bytes_.clear();
+	modified_.clear();
+	annotation_.clear();
+	content_hash_.clear();
+	perceptual_hash_.clear();
+	group_.clear();
+	duplicates_.clear();
+	endResetModel();
+}
+
+//! Returns the shown image as the Image struct
+Image
+ImageListModel::image(int aRow) const
+{
+	return imageById(rows_.at(aRow));
+}
+
+//! Replaces everything except the path of the shown image
+void
+ImageListModel::setImage(int aRow, const Image &anImage)
+{
+	if (aRow < 0 || count() <= aRow) {
+		return;
+		/* NOTREACHED */
+	}
+
+	setImageById(rows_.at(aRow), anImage);
+}
+
+//! Returns the full path to the shown image
+QString
+ImageListModel::path(int aRow) const
+{
+	return pathById(rows_.at(aRow));
+}
+
+//! Returns the file name of the shown image without the path
+QString
+ImageListModel::fileName(int aRow) const
+{
+	int id = rows_.at(aRow);
+	return names_.mid(name_offset_.at(id), name_length_.at(id));
+}
+
+//! Returns true if there is a labeling data for the shown image
+bool
+ImageListModel::isLabeled(int aRow) const
+{
+	return flags_.at(rows_.at(aRow)) & Labeled;
+}
+
+//! Returns true if the shown image was loaded from the PASCAL file
+bool
+ImageListModel::isPascal(int aRow) const
+{
+	return flags_.at(rows_.at(aRow)) & Pascal;
+}
+
+//! Returns the id of the image shown in aRow
+int
+ImageListModel::idOfRow(int aRow) const
+{
+	if (aRow < 0 || count() <= aRow)
+		return -1;
+
+	return rows_.at(aRow);
+}
+
+//! Returns the row the image is shown in, -1 if it is not shown
+/*!
+ * Rows shifted by the removals(see removeById()) are looked up again
+ * all at once when one of them is asked for.
+ */
+int
+ImageListModel::rowOfId(int anId) const
+{
+	if (anId < 0 || row_of_id_.count() <= anId)
+		return -1;
+
+	if (indexed_rows_ <= row_of_id_.at(anId))
+		indexRows(indexed_rows_);
+
+	return row_of_id_.at(anId);
+}
+
+//! Returns the image as the Image struct
+Image
+ImageListModel::imageById(int anId) const
+{
+	Image result;
+	result.image_ = pathById(anId);
+	result.labeled_ = flags_.at(anId) & Labeled;
+	result.pas_ = flags_.at(anId) & Pascal;
+	result.size_ = size_.at(anId);
+	result.bytes_ = bytes_.at(anId);
+	result.modified_ = modified_.at(anId);
+	result.annotation_ = annotation_.at(anId);
+	result.content_hash_ = content_hash_.at(anId);
+	result.perceptual_hash_ = perceptual_hash_.at(anId);
+
+	return result;
+}
+
+//! Replaces everything except the path of the image
+void
+ImageListModel::setImageById(int anId, const Image &anImage)
+{
+	if (anId < 0 || directory_.count() <= anId) {
+		return;
+		/* NOTREACHED */
+	}
+
+	flags_[anId] = imageFlags(anImage) | (flags_.at(anId) & Removed);
+	size_[anId] = anImage.size_;
+	bytes_[anId] = anImage.bytes_;
+	modified_[anId] = anImage.modified_;
+	annotation_[anId] = anImage.annotation_;
+	content_hash_[anId] = anImage.content_hash_;
+	perceptual_hash_[anId] = anImage.perceptual_hash_;
+
+	int row = rowOfId(anId);
+	if (0 <= row)
+		emit dataChanged(index(row), index(row));
+}
+
+//! Returns ids of all the images located right in aDir
+QList< int >
+ImageListModel::idsInDirectory(const QString &aDir) const
+{
+	QList< int > ids;
+	int dirId = directory_ids_.value(aDir + QString("/"), -1);
+	if (dirId < 0) {
+		return ids;
+		/* NOTREACHED */
+	}
+
+	for (int i = 0; i < directory_.count(); i++) {
+		if (dirId == directory_.at(i) && !(flags_.at(i) & Removed))
+			ids.append(i);
+	}
+
+	return ids;
+}
+
+//! Returns all the labeled images lying somewhere inside aRoot
+QList< Image >
+ImageListModel::labeledImages(const QString &aRoot) const
+{
+	QString prefix = aRoot;
+	if (!prefix.endsWith('/'))
+		prefix.append('/');
+
+	/* checking directories once instead of every image */
+	QVector< bool > inside(directories_.count());
+	for (int i = 0; i < directories_.count(); i++)
+		inside[i] = directories_.at(i).startsWith(prefix);
+
+	QList< Image > images;
+	for (int i = 0; i < directory_.count(); i++) {
+		if (Labeled == (flags_.at(i) & (Labeled | Removed)) &&
+			inside.at(directory_.at(i)))
+		{
+			images.append(imageById(i));
+		}
+	}
+
+	return images;
+}
+
+//! Shows only the images passing the filter
+/*!
+ * \param[in] aFilter which images are shown
+ * \param[in] aPaths paths of the images shown by the SelectedImages filter
+ *
+ * Rows of the images change, ids stay the same.
+ */
+void
+ImageListModel::setFilter(
+	Filter aFilter,
+	const QSet< QString > &aPaths
+)
+{
+	beginResetModel();
+	filter_ = aFilter;
+	filter_paths_ = aPaths;
+	buildRows();
+	endResetModel();
+}
+
+//! Returns the current filter
+ImageListModel::Filter
+ImageListModel::filter() const
+{
+	return filter_;
+}
+
+//! Returns the columns the images are sorted by
+/*!
+ * Nothing is copied, the columns are implicitly shared.
+ * \see ImageSorter::sort()
+ */
+SortColumns
+ImageListModel::sortColumns() const
+{
+	SortColumns columns;
+	columns.directories_ = directories_;
+	columns.directory_ = directory_;
+	columns.names_ = names_;
+	columns.name_offset_ = name_offset_;
+	columns.name_length_ = name_length_;
+	columns.flags_ = flags_;
+	columns.bytes_ = bytes_;
+	columns.modified_ = modified_;
+
+	return columns;
+}
+
+//! Shows the images in the order
+/*!
+ * \param[in] anOrder ids of the images in the order they should be shown,
+ * images added after it was computed are shown after them
+ *
+ * \see ImageSorter::sort()
+ */
+void
+ImageListModel::setOrder(const QVector< int > &anOrder)
+{
+	beginResetModel();
+	order_ = anOrder;
+	buildRows();
+	endResetModel();
+}
+
+//! \brief Returns the hashes of all the images by id for finding
+//! duplicates, hashes of the removed images are 0
+void
+ImageListModel::hashes(
+	QVector< quint64 > *aContent,
+	QVector< quint64 > *aPerceptual
+) const
+{
+	*aContent = content_hash_;
+	*aPerceptual = perceptual_hash_;
+	for (int id = 0; id < flags_.count(); id++) {
+		if (flags_.at(id) & Removed) {
+			(*aContent)[id] = 0;
+			(*aPerceptual)[id] = 0;
+		}
+	}
+}
+
+//! Marks the images which are duplicates of each other
+/*!
+ * \param[in] aGroups ids of the images grouped by DuplicateFinder::groups()
+ *
+ * Images added later are not in any group till the next call.
+ */
+void
+ImageListModel::setDuplicateGroups(const QList< QVector< int > > &aGroups)
+{
+	group_.fill(-1, directory_.count());
+	duplicates_.clear();
+	for (int group = 0; group < aGroups.count(); group++) {
+		foreach (int id, aGroups.at(group)) {
+			if (id < 0 || group_.count() <= id)
+				continue;
+			group_[id] = group;
+			duplicates_.append(id);
+		}
+	}
+
+	if (DuplicateImages == filter_)
+		setFilter(filter_, filter_paths_);
+	else if (count())
+		emit dataChanged(index(0), index(count() - 1));
+}
+
+//! Sets the cache the thumbnails are taken from
+void
+ImageListModel::setThumbnailCache(ThumbnailCache *aCache)
+{
+	if (thumbnail_cache_)
+		thumbnail_cache_->disconnect(this);
+
+	thumbnail_cache_ = aCache;
+	if (!thumbnail_cache_) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int size = thumbnail_cache_->thumbnailSize();
+	thumbnail_placeholder_ = QPixmap(size, size);
+	thumbnail_placeholder_.fill(Qt::transparent);
+
+	connect(
+		thumbnail_cache_,
+		SIGNAL(thumbnailReady(const QString &, const QImage &)),
+		this,
+		SLOT(onThumbnailReady(const QString &))
+		);
+}
+
+//! Shows or hides thumbnails
+void
+ImageListModel::setThumbnailsVisible(bool aVisible)
+{
+	thumbnails_visible_ = aVisible;
+
+	if (thumbnail_cache_)
+		thumbnail_cache_->clearRequests();
+	if (count())
+		emit dataChanged(index(0), index(count() - 1));
+}
+
+//! \brief A slot member repainting the row of the image whose thumbnail
+//! is ready
+void
+ImageListModel::onThumbnailReady(const QString &aPath)
+{
+	QHash< QString, int >::iterator waiting = waiting_thumbnails_.find(aPath);
+	if (waiting_thumbnails_.end() == waiting) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int row = rowOfId(waiting.value());
+	waiting_thumbnails_.erase(waiting);
+
+	if (thumbnails_visible_ && 0 <= row)
+		emit dataChanged(index(row), index(row));
+}
+
+//! Appends the image to all the columns
+void
+ImageListModel::store(const Image &anImage)
+{
+	int slash = anImage.image_.lastIndexOf('/');
+	QString name = anImage.image_.mid(slash + 1);
+
+	/* directories are kept with the trailing slash */
+	directory_.append(directoryId(anImage.image_.left(slash + 1)));
+	name_offset_.append(names_.length());
+	name_length_.append(name.length());
+	names_.append(name);
+	flags_.append(imageFlags(anImage));
+	size_.append(anImage.size_);
+	bytes_.append(anImage.bytes_);
+	modified_.append(anImage.modified_);
+	annotation_.append(anImage.annotation_);
+	content_hash_.append(anImage.content_hash_);
+	perceptual_hash_.append(anImage.perceptual_hash_);
+	group_.append(-1);
+}
+
+//! Returns the number of the directory, adds it if it is new
+int
+ImageListModel::directoryId(const QString &aDir)
+{
+	QHash< QString, int >::const_iterator found = directory_ids_.find(aDir);
+	if (found != directory_ids_.constEnd())
+		return found.value();
+
+	directories_.append(aDir);
+	directory_ids_.insert(aDir, directories_.count() - 1);
+
+	return directories_.count() - 1;
+}
+
+//! Returns the full path to the image
+QString
+ImageListModel::pathById(int anId) const
+{
+	return directories_.at(directory_.at(anId)) +
+		names_.mid(name_offset_.at(anId), name_length_.at(anId));
+}
+
+//! Fills the rows_ with the images passing the filter in the order_
+void
+ImageListModel::buildRows()
+{
+	rows_.clear();
+	row_of_id_.clear();
+	if (DuplicateImages == filter_) {
+		foreach (int id, duplicates_) {
+			if (accepts(id))
+				rows_.append(id);
+		}
+		indexRows(0);
+		return;
+		/* NOTREACHED */
+	}
+
+	/* the order could be computed before some images were added */
+	int ordered = qMin(order_.count(), directory_.count());
+	for (int i = 0; i < ordered; i++) {
+		if (order_.at(i) < directory_.count() && accepts(order_.at(i)))
+			rows_.append(order_.at(i));
+	}
+	for (int id = ordered; id < directory_.count(); id++) {
+		if (accepts(id))
+			rows_.append(id);
+	}
+	indexRows(0);
+}
+
+//! \brief Updates row_of_id_ for the rows since aFirstRow, the rest of
+//! the rows should be the same as before
+void
+ImageListModel::indexRows(int aFirstRow) const
+{
+	while (row_of_id_.count() < directory_.count())
+		row_of_id_.append(-1);
+
+	for (int row = aFirstRow; row < rows_.count(); row++)
+		row_of_id_[rows_.at(row)] = row;
+
+	if (aFirstRow <= indexed_rows_)
+		indexed_rows_ = rows_.count();
+}
+
+//! Returns true if the image passes the filter
+bool
+ImageListModel::accepts(int anId) const
+{
+	quint8 flags = flags_.at(anId);
+	if (flags & Removed)
+		return false;
+
+	switch (filter_) {
+	case UnlabeledImages:
+		return !(flags & Labeled);
+	case SelectedImages:
+		return (flags & Labeled) && filter_paths_.contains(pathById(anId));
+	case DuplicateImages:
+		return 0 <= group_.at(anId);
+	default:
+		return true;
+	}
+}
+
+/*
+ *
+ */
@@ -0,0 +1,209 @@
+/*!
+ * \file ImageListModel.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __IMAGELISTMODEL_H__
+#define __IMAGELISTMODEL_H__
+
+#include "ImageScanner.h"
+#include "ImageSorter.h"
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QPixmap>
+
+/* forward declarations */
+class ThumbnailCache;
+
+//! \brief Model of the loaded images for the image list view.
+/*!
+ * Images are kept column by column instead of a list of Image structs:
+ * directories are stored once and referred by number, all the file names
+ * are kept in one string and flags are packed into bits. So a list of
+ * millions of images takes a fraction of memory and the view asks only
+ * for the rows it shows(it should have uniform item sizes).
+ *
+ * The number shown for the image is its row. Removing an image shifts
+ * the ids of the following rows by one, but their rows are looked up
+ * again(see rowOfId()) only when one of them is asked for, so removing
+ * images from the end of the list one by one stays cheap.
+ *
+ * Images are stored under ids which never change till clear(), rows are
+ * the images passing the filter(see setFilter()) in the order they are
+ * shown. Everything taking a row works with the shown images only, the
+ * functions taking an id work with all of them. The DuplicateImages filter
+ * shows the groups of duplicates one after another, the rest of filters
+ * show the images in the order set by setOrder().
+ *
+ * \see ImageLabeler::list_images_
+ */
+class ImageListModel : public QAbstractListModel
+{
+	Q_OBJECT
+public:
+	//! bits of the flags column
+	enum Flag {
+		Labeled = 0x01,
+		Pascal = 0x02,
+		Huge = 0x04,
+		Removed = 0x08
+	};
+
+	//! \brief which images are shown
+	//! \see setFilter()
+	enum Filter {
+		AllImages,
+		UnlabeledImages,
+		SelectedImages,
+		DuplicateImages
+	};
+
+	ImageListModel(QObject *aParent = 0);
+	virtual ~ImageListModel();
+
+	int rowCount(const QModelIndex &aParent = QModelIndex()) const;
+	QVariant data(const QModelIndex &anIndex, int aRole = Qt::DisplayRole) const;
+
+	int count() const;
+	bool isEmpty() const;
+	void append(const Image &anImage);
+	void append(const QList< Image > &anImages);
+	void remove(int aRow);
+	void removeById(int anId);
+	void clear();
+	Image image(int aRow) const;
+	void setImage(int aRow, const Image &anImage);
+	QString path(int aRow) const;
+	QString fileName(int aRow) const;
+	bool isLabeled(int aRow) const;
+	bool isPascal(int aRow) const;
+	int idOfRow(int aRow) const;
+	int rowOfId(int anId) const;
+	Image imageById(int anId) const;
+	void setImageById(int anId, const Image &anImage);
+	QList< int > idsInDirectory(const QString &aDir) const;
+	QList< Image > labeledImages(const QString &aRoot) const;
+	void setFilter(
+		Filter aFilter,
+		const QSet< QString > &aPaths = QSet< QString >()
+		);
+	Filter filter() const;
+	void hashes(
+		QVector< quint64 > *aContent,
+		QVector< quint64 > *aPerceptual
+		) const;
+	void setDuplicateGroups(const QList< QVector< int > > &aGroups);
+	SortColumns sortColumns() const;
+	void setOrder(const QVector< int > &anOrder);
+	void setThumbnailCache(ThumbnailCache *aCache);
+	void setThumbnailsVisible(bool aVisible);
+
+private slots:
+	void onThumbnailReady(const QString &aPath);
+
+private:
+	void store(const Image &anImage);
+	int directoryId(const QString &aDir);
+	QString pathById(int anId) const;
+	bool accepts(int anId) const;
+	void buildRows();
+	void indexRows(int aFirstRow) const;
+
+	//! all the directories(with the trailing slash), each one is stored once
+	QStringList directories_;
+
+	//! numbers of the directories in the directories_
+	QHash< QString, int > directory_ids_;
+
+	//! \brief ids of the images shown, in the order they are shown
+	//! \see setFilter()
+	QVector< int > rows_;
+
+	//! \brief rows of the images by id, -1 for the images not shown,
+	//! the rows since indexed_rows_ could be out of date
+	//! \see rowOfId()
+	mutable QVector< int > row_of_id_;
+
+	//! number of the first rows_ which are up to date in the row_of_id_
+	mutable int indexed_rows_;
+
+	//! \brief ids of the images in the order they are shown, empty for
+	//! the order they were added in
+	//! \see setOrder()
+	QVector< int > order_;
+
+	//! \brief which images are shown
+	//! \see setFilter()
+	Filter filter_;
+
+	//! \brief paths of the images shown by the SelectedImages filter
+	QSet< QString > filter_paths_;
+
+	//! number of the directory of the image in the directories_
+	QVector< int > directory_;
+
+	//! all the file names one after another
+	QString names_;
+
+	//! position of the file name in the names_
+	QVector< int > name_offset_;
+
+	//! length of the file name in the names_
+	QVector< int > name_length_;
+
+	//! \brief Flag bits of the image
+	//! \see Flag
+	QVector< quint8 > flags_;
+
+	//! size of the image read from its header
+	QVector< QSize > size_;
+
+	//! size of the image file
+	QVector< qint64 > bytes_;
+
+	//! modification time of the image file
+	QVector< uint > modified_;
+
+	//! hash of the labeling data
+	QVector< quint64 > annotation_;
+
+	//! \brief hashes of the image file and picture
+	//! \see DuplicateFinder
+	QVector< quint64 > content_hash_;
+	QVector< quint64 > perceptual_hash_;
+
+	//! \brief number of the group of duplicates the image belongs to, -1 if
+	//! it has no duplicates
+	//! \see setDuplicateGroups()
+	QVector< int > group_;
+
+	//! ids of all the duplicates group by group
+	QVector< int > duplicates_;
+
+	//! \brief source of the thumbnails
+	//! \see setThumbnailsVisible(bool aVisible)
+	ThumbnailCache *thumbnail_cache_;
+
+	//! whether thumbnails are shown
+	bool thumbnails_visible_;
+
+	//! empty picture keeping the height of rows without thumbnails
+	QPixmap thumbnail_placeholder_;
+
+	//! \brief ids of the images shown without thumbnails, by path
+	//! \see onThumbnailReady(const QString &aPath)
+	mutable QHash< QString, int > waiting_thumbnails_;
+};
+
+#endif /* __IMAGELISTMODEL_H__ */
+
+/*
+ *
+ */
@@ -0,0 +1,514 @@
+/*
+ * ImagePyramid.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ImagePyramid.h"
+#include "Instrumentation.h"
+
+#include <QtConcurrentRun>
+#include <QThread>
+#include <QDebug>
+
+//! Returns anImage scaled to aSize(runs in a worker thread)
+static QImage
+scaleImageTo(const QImage &anImage, const QSize &aSize)
+{
+	return anImage.scaled(
+		aSize,
+		Qt::IgnoreAspectRatio,
+		Qt::SmoothTransformation
+		);
+}
+
+//! Decodes a region of aSource scaled to aSize(runs in a worker thread)
+static QImage
+decodeRegion(
+	const TiledImageSource &aSource,
+	const QRect &aRect,
+	const QSize &aSize
+)
+{
+	ScopedTiming timing("tile decode, ms");
+	return aSource.decode(aRect, aSize);
+}
+
+//! A constructor initializing some variables
+ImagePyramid::ImagePyramid(QObject *aParent)
+	: QObject(aParent)
+{
+	requested_level_ = 0;
+	generation_ = 0;
+	building_generation_ = 0;
+	building_level_ = -1;
+	tile_size_ = 256;
+
+	/* 64 MB of pixmaps at most */
+	tiles_.setMaxCost(64 * 1024);
+
+	watcher_ = new QFutureWatcher< QImage >(this);
+	connect(
+		watcher_,
+		SIGNAL(finished()),
+		this,
+		SLOT(onLevelBuilt())
+		);
+}
+
+//! A destructor waiting for the level being built
+ImagePyramid::~ImagePyramid()
+{
+	watcher_->waitForFinished();
+}
+
+//! Drops everything and prepares empty levels for the image of aSize
+void
+ImagePyramid::init(const QSize &aSize)
+{
+	clear();
+
+	if (aSize.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	size_ = aSize;
+
+	/* halving until the whole level fits into one tile */
+	QSize levelSize = aSize;
+	int levelCount = 1;
+	while (tile_size_ < levelSize.width() ||
+		tile_size_ < levelSize.height())
+	{
+		levelSize = halvedSize(levelSize, 1);
+		levelCount++;
+	}
+
+	levels_.resize(levelCount);
+}
+
+//! Drops all the levels and makes anImage level 0
+/*!
+ * \param[in] anImage the original image
+ *
+ * Coarser levels are not built here, see requestLevel(int aLevel)
+ */
+void
+ImagePyramid::setImage(const QImage &anImage)
+{
+	init(anImage.size());
+
+	if (isNull()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	levels_[0] = anImage;
+}
+
+//! Drops all the levels and shows aPreview until setImage() is called
+/*!
+ * \param[in] aSize a size of the original image
+ * \param[in] aLevel a level aPreview corresponds to
+ * \param[in] aPreview a reduced image of halvedSize(aSize, aLevel) size
+ *
+ * Levels finer than aLevel are not available until the original image
+ * is set, requestLevel(int aLevel) returns aLevel for them.
+ */
+void
+ImagePyramid::setPreview(
+	const QSize &aSize,
+	int aLevel,
+	const QImage &aPreview
+)
+{
+	init(aSize);
+
+	if (isNull() || aLevel < 0 || levels_.count() <= aLevel) {
+		return;
+		/* NOTREACHED */
+	}
+
+	if (aPreview.size() == levelSize(aLevel))
+		levels_[aLevel] = aPreview;
+	else
+		levels_[aLevel] = scaleImageTo(aPreview, levelSize(aLevel));
+}
+
+//! Drops all the levels and switches to decoding tiles from aSource
+/*!
+ * \param[in] aSource the image file which should support decoding by regions
+ *
+ * Only the overview(the coarsest level) is decoded here, in the background
+ */
+void
+ImagePyramid::setSource(const TiledImageSource &aSource)
+{
+	init(aSource.size());
+
+	if (isNull()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	source_ = aSource;
+	decodeTile(coarsestLevel(), 0, 0);
+}
+
+//! Drops all the levels and tiles
+void
+ImagePyramid::clear()
+{
+	generation_++;
+	levels_.clear();
+	tiles_.clear();
+	/* watchers delete themselves when the decoding is over */
+	decoding_.clear();
+	size_ = QSize();
+	source_ = TiledImageSource();
+	requested_level_ = 0;
+}
+
+//! Returns true if there is no image in the pyramid
+bool
+ImagePyramid::isNull() const
+{
+	return size_.isEmpty();
+}
+
+//! Returns true if the tiles are decoded from the TiledImageSource
+bool
+ImagePyramid::isTiled() const
+{
+	return source_.isValid();
+}
+
+//! Returns the size of the original image
+QSize
+ImagePyramid::size() const
+{
+	return size_;
+}
+
+//! Returns the number of levels the pyramid has when fully built
+int
+ImagePyramid::levelCount() const
+{
+	return levels_.count();
+}
+
+//! Returns the number of the smallest level
+int
+ImagePyramid::coarsestLevel() const
+{
+	return levels_.count() - 1;
+}
+
+//! Returns the level which is the most suitable for drawing at aScale
+/*!
+ * \param[in] aScale a scale of the image(see ImageHolder::scale_)
+ *
+ * It is the coarsest level that is still not smaller than the image
+ * drawn at aScale, so tiles are only scaled down during painting.
+ */
+int
+ImagePyramid::levelForScale(const double &aScale) const
+{
+	int level = 0;
+	double scale = aScale;
+
+	while (scale * 2 <= 1 && level < coarsestLevel()) {
+		scale *= 2;
+		level++;
+	}
+
+	return level;
+}
+
+//! Asks for the level and returns the closest level which is ready
+/*!
+ * \param[in] aLevel a level needed for drawing
+ *
+ * If aLevel is not built yet, it starts building it in the background
+ * (levelReady(int) is emitted for every new level) and returns
+ * the closest of already built levels(finer levels are preferred).
+ * In the tiled mode any level is ready, its tiles are decoded one by one.
+ *
+ * Returns -1 if there is no level to draw at all.
+ */
+int
+ImagePyramid::requestLevel(int aLevel)
+{
+	if (isNull()) {
+		return -1;
+		/* NOTREACHED */
+	}
+
+	int level = qBound(0, aLevel, coarsestLevel());
+	if (isTiled() || !levels_.at(level).isNull()) {
+		return level;
+		/* NOTREACHED */
+	}
+
+	requested_level_ = level;
+	if (!watcher_->isRunning())
+		buildNextLevel();
+
+	for (int i = 1; i < levels_.count(); i++) {
+		if (0 <= level - i && !levels_.at(level - i).isNull())
+			return level - i;
+		if (level + i < levels_.count() && !levels_.at(level + i).isNull())
+			return level + i;
+	}
+
+	return -1;
+}
+
+//! Returns the size of the level(even if it is not built yet)
+QSize
+ImagePyramid::levelSize(int aLevel) const
+{
+	return halvedSize(size_, aLevel);
+}
+
+//! Returns aSize divided by two aTimes times(the same way levels are built)
+QSize
+ImagePyramid::halvedSize(const QSize &aSize, int aTimes)
+{
+	QSize size = aSize;
+	for (int i = 0; i < aTimes; i++) {
+		size.setWidth(qMax(1, size.width() / 2));
+		size.setHeight(qMax(1, size.height() / 2));
+	}
+
+	return size;
+}
+
+//! Returns width and height of the tile
+int
+ImagePyramid::tileSize() const
+{
+	return tile_size_;
+}
+
+//! Returns the rectangle of the tile in coordinates of the level
+QRect
+ImagePyramid::tileRect(int aLevel, int aColumn, int aRow) const
+{
+	QRect rect(
+		aColumn * tile_size_,
+		aRow * tile_size_,
+		tile_size_,
+		tile_size_
+		);
+
+	return rect.intersected(QRect(QPoint(0, 0), levelSize(aLevel)));
+}
+
+//! Returns the key of the tile in tiles_ and decoding_
+quint64
+ImagePyramid::tileKey(int aLevel, int aColumn, int aRow) const
+{
+	return
+		(quint64(aLevel) << 48) |
+		(quint64(aRow) << 24) |
+		quint64(aColumn);
+}
+
+//! Returns the tile of the level as a pixmap ready for drawing
+/*!
+ * \param[in] aLevel a level of the tile
+ * \param[in] aColumn a column of the tile
+ * \param[in] aRow a row of the tile
+ *
+ * Pixmaps are cached, so only the tiles which have not been drawn recently
+ * are converted. In the tiled mode a null pixmap is returned if the tile
+ * is not decoded yet, decoding starts in the background and
+ * tileReady(int, int, int) is emitted when it is over.
+ */
+QPixmap
+ImagePyramid::tile(int aLevel, int aColumn, int aRow)
+{
+	if (aLevel < 0 || levels_.count() <= aLevel) {
+		return QPixmap();
+		/* NOTREACHED */
+	}
+
+	quint64 key = tileKey(aLevel, aColumn, aRow);
+
+	QPixmap *cached = tiles_.object(key);
+	Instrumentation::addLookup("tile cache", cached);
+	if (cached)
+		return *cached;
+
+	QRect rect = tileRect(aLevel, aColumn, aRow);
+	if (rect.isEmpty()) {
+		return QPixmap();
+		/* NOTREACHED */
+	}
+
+	if (levels_.at(aLevel).isNull()) {
+		if (isTiled())
+			decodeTile(aLevel, aColumn, aRow);
+		return QPixmap();
+		/* NOTREACHED */
+	}
+
+	QPixmap pixmap = QPixmap::fromImage(levels_.at(aLevel).copy(rect));
+	int cost = qMax(1, rect.width() * rect.height() * 4 / 1024);
+	tiles_.insert(key, new QPixmap(pixmap), cost);
+
+	return pixmap;
+}
+
+//! \brief Returns the coarsest level as a pixmap(null if it is not ready),
+//! it is drawn in place of the tiles which are not decoded yet
+QPixmap
+ImagePyramid::overview()
+{
+	return tile(coarsestLevel(), 0, 0);
+}
+
+//! Starts building the first missing level which can be built
+void
+ImagePyramid::buildNextLevel()
+{
+	for (int i = 1; i <= requested_level_ && i < levels_.count(); i++) {
+		if (levels_.at(i).isNull() && !levels_.at(i - 1).isNull()) {
+			building_level_ = i;
+			building_generation_ = generation_;
+			watcher_->setFuture(
+				QtConcurrent::run(scaleImageTo, levels_.at(i - 1), levelSize(i))
+				);
+			return;
+			/* NOTREACHED */
+		}
+	}
+}
+
+//! \brief A slot member being called when the worker thread finished
+//! building the level
+void
+ImagePyramid::onLevelBuilt()
+{
+	QImage level = watcher_->result();
+
+	/* the image was changed while the level was being built */
+	if (building_generation_ != generation_ ||
+		levels_.count() <= building_level_)
+	{
+		buildNextLevel();
+		return;
+		/* NOTREACHED */
+	}
+
+	levels_[building_level_] = level;
+	emit levelReady(building_level_);
+
+	buildNextLevel();
+}
+
+//! Starts decoding the tile from source_ in a worker thread
+/*!
+ * The number of tiles being decoded at the same time is limited, the rest
+ * will be asked again on the next repaint.
+ */
+void
+ImagePyramid::decodeTile(int aLevel, int aColumn, int aRow)
+{
+	quint64 key = tileKey(aLevel, aColumn, aRow);
+	if (decoding_.contains(key)) {
+		return;
+		/* NOTREACHED */
+	}
+
+	/* the overview is always decoded first */
+	if (aLevel != coarsestLevel() &&
+		QThread::idealThreadCount() * 2 <= decoding_.count())
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	QRect rect = tileRect(aLevel, aColumn, aRow);
+	QSize levelSize = this->levelSize(aLevel);
+
+	/* the same region in coordinates of the original image */
+	QRect sourceRect(
+		QPoint(
+			qint64(rect.left()) * size_.width() / levelSize.width(),
+			qint64(rect.top()) * size_.height() / levelSize.height()
+			),
+		QPoint(
+			qint64(rect.right() + 1) * size_.width() / levelSize.width() - 1,
+			qint64(rect.bottom() + 1) * size_.height() / levelSize.height() - 1
+			)
+		);
+
+	QFutureWatcher< QImage > *watcher = new QFutureWatcher< QImage >(this);
+	watcher->setProperty("level", aLevel);
+	watcher->setProperty("column", aColumn);
+	watcher->setProperty("row", aRow);
+	watcher->setProperty("generation", generation_);
+	connect(
+		watcher,
+		SIGNAL(finished()),
+		this,
+		SLOT(onTileDecoded())
+		);
+	decoding_.insert(key, watcher);
+
+	watcher->setFuture(
+		QtConcurrent::run(decodeRegion, source_, sourceRect, rect.size())
+		);
+}
+
+//! \brief A slot member being called when the worker thread finished
+//! decoding the tile
+void
+ImagePyramid::onTileDecoded()
+{
+	QFutureWatcher< QImage > *watcher =
+		static_cast< QFutureWatcher< QImage > * >(sender());
+	if (!watcher) {
+		return;
+		/* NOTREACHED */
+	}
+
+	int level = watcher->property("level").toInt();
+	int column = watcher->property("column").toInt();
+	int row = watcher->property("row").toInt();
+	int generation = watcher->property("generation").toInt();
+	quint64 key = tileKey(level, column, row);
+
+	if (decoding_.value(key) == watcher)
+		decoding_.remove(key);
+
+	QImage image = watcher->result();
+	watcher->deleteLater();
+
+	/* the image was changed while the tile was being decoded */
+	if (generation != generation_ || image.isNull() ||
+		levels_.count() <= level)
+	{
+		return;
+		/* NOTREACHED */
+	}
+
+	/* the overview is kept in memory all the time */
+	if (coarsestLevel() == level) {
+		levels_[level] = image;
+	}
+	else {
+		int cost = qMax(1, image.width() * image.height() * 4 / 1024);
+		tiles_.insert(key, new QPixmap(QPixmap::fromImage(image)), cost);
+	}
+
+	emit tileReady(level, column, row);
+}
+
+/*
+ *
+ */
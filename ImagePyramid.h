@@ -0,0 +1,132 @@
+/*!
+ * \file ImagePyramid.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __IMAGEPYRAMID_H__
+#define __IMAGEPYRAMID_H__
+
+#include "TiledImageSource.h"
+
+#include <QObject>
+#include <QImage>
+#include <QPixmap>
+#include <QVector>
+#include <QHash>
+#include <QCache>
+#include <QFutureWatcher>
+
+//! \brief Multi-resolution representation of the image split into tiles.
+/*!
+ * Level 0 is the original image, every next level is two times smaller
+ * than the previous one. Coarser levels are built lazily in a worker thread
+ * only when somebody asks for them(see requestLevel(int aLevel)), so opening
+ * a huge image costs nothing until the user zooms out.
+ *
+ * While the original image is being decoded the pyramid can show a reduced
+ * preview of it as one of the coarser levels(see setPreview()), all the
+ * coordinates stay in the original resolution.
+ *
+ * If the image is too big to be kept in memory the pyramid works with
+ * TiledImageSource(see setSource(const TiledImageSource &aSource)): no level
+ * is kept as a whole, tiles of any level are decoded in worker threads
+ * when they are needed for drawing and only the coarsest level(overview) is
+ * always in memory.
+ *
+ * Tiles are converted to QPixmap on demand and kept in a bounded cache,
+ * so the painting cost depends on the viewport size, not on the image size.
+ *
+ * \see ImageHolder::drawImage(QPainter *aPainter, const QRect &anExposedRect)
+ */
+class ImagePyramid : public QObject
+{
+	Q_OBJECT
+public:
+	ImagePyramid(QObject *aParent = 0);
+	virtual ~ImagePyramid();
+
+	void setImage(const QImage &anImage);
+	void setSource(const TiledImageSource &aSource);
+	void setPreview(
+		const QSize &aSize,
+		int aLevel,
+		const QImage &aPreview
+		);
+	void clear();
+	bool isNull() const;
+	bool isTiled() const;
+	QSize size() const;
+	int levelCount() const;
+	int levelForScale(const double &aScale) const;
+	int requestLevel(int aLevel);
+	QSize levelSize(int aLevel) const;
+	int tileSize() const;
+	QRect tileRect(int aLevel, int aColumn, int aRow) const;
+	QPixmap tile(int aLevel, int aColumn, int aRow);
+	QPixmap overview();
+
+	static QSize halvedSize(const QSize &aSize, int aTimes);
+
+signals:
+	//! emitted every time a new coarser level was built in the background
+	void levelReady(int aLevel);
+	//! emitted every time a tile was decoded from the source
+	void tileReady(int aLevel, int aColumn, int aRow);
+
+private slots:
+	void onLevelBuilt();
+	void onTileDecoded();
+
+private:
+	void init(const QSize &aSize);
+	void buildNextLevel();
+	void decodeTile(int aLevel, int aColumn, int aRow);
+	int coarsestLevel() const;
+	quint64 tileKey(int aLevel, int aColumn, int aRow) const;
+
+	//! \brief levels kept in memory, null if the level is not built
+	//! (levels_[0] is null in the tiled mode)
+	QVector< QImage > levels_;
+
+	//! size of the original image
+	QSize size_;
+
+	//! \brief image file the tiles are decoded from
+	//! \see setSource(const TiledImageSource &aSource)
+	TiledImageSource source_;
+
+	//! \brief the coarsest level somebody asked for
+	//! \see requestLevel(int aLevel)
+	int requested_level_;
+
+	//! incremented on every setImage() to drop results of outdated builds
+	int generation_;
+
+	//! generation_ value at the moment the running build was started
+	int building_generation_;
+
+	//! the level being built by the running build
+	int building_level_;
+
+	//! watches the level being built in the worker thread
+	QFutureWatcher< QImage > *watcher_;
+
+	//! \brief tiles being decoded at the moment
+	//! \see decodeTile(int aLevel, int aColumn, int aRow)
+	QHash< quint64, QFutureWatcher< QImage > * > decoding_;
+
+	//! \brief tiles converted to pixmaps, cost is measured in kilobytes
+	//! \see tile(int aLevel, int aColumn, int aRow)
+	QCache< quint64, QPixmap > tiles_;
+
+	//! width and height of the tile in pixels
+	int tile_size_;
+};
+
+#endif /* __IMAGEPYRAMID_H__ */
+
+/*
+ *
+ */
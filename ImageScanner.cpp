@@ -0,0 +1,403 @@
+/*
+ * ImageScanner.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ImageScanner.h"
+#include "DatasetManifest.h"
+#include "DuplicateFinder.h"
+#include "ImageArchive.h"
+#include "functions.h"
+
+#include <QtConcurrentMap>
+#include <QImageReader>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTime>
+#include <QHash>
+#include <QDebug>
+
+//! \brief Takes the key of the labeling data of the image listed during
+//! the previous scan again
+/*!
+ * The data file can be rewritten in place without changing the
+ * modification time of the directory.
+ */
+static void
+restatAnnotation(Image &anImage)
+{
+	if (anImage.labeled_) {
+		anImage.annotation_ =
+			ImageScanner::annotationKey(ImageArchive::dataFile(anImage.image_));
+	}
+}
+
+//! \brief Applies a function to the images till the scan is cancelled,
+//! the rest of the images are skipped at once
+struct UnlessCancelled {
+	typedef void result_type;
+
+	UnlessCancelled(void (*aFunction)(Image &), const QAtomicInt *aCancelled)
+		: function_(aFunction), cancelled_(aCancelled)
+	{}
+
+	void operator()(Image &anImage) const
+	{
+		if (!cancelled_ || !*cancelled_)
+			function_(anImage);
+	}
+
+	void (*function_)(Image &);
+	const QAtomicInt *cancelled_;
+};
+
+//! A constructor initializing some variables
+ImageScanner::ImageScanner(QObject *aParent)
+	: QThread(aParent)
+{
+	generation_ = 0;
+	hashing_ = 0;
+	batch_size_ = 4096;
+	batch_interval_ = 500;
+
+	qRegisterMetaType< QList< Image > >("QList<Image>");
+}
+
+//! A destructor stopping the scan
+ImageScanner::~ImageScanner()
+{
+	cancel();
+	wait();
+}
+
+//! Starts looking for the images in aRoot, the running scan is cancelled
+/*!
+ * \param[in] aRoot a path to the directory to scan recursively
+ */
+void
+ImageScanner::scan(const QString &aRoot)
+{
+	cancel();
+	wait();
+
+	root_ = aRoot;
+	generation_++;
+	cancelled_ = 0;
+
+	start(QThread::LowPriority);
+}
+
+//! Asks the running scan to stop as soon as possible
+void
+ImageScanner::cancel()
+{
+	cancelled_ = 1;
+}
+
+//! Returns true if the last scan was cancelled
+bool
+ImageScanner::isCancelled() const
+{
+	return cancelled_;
+}
+
+//! \brief Asks the scanner to compute the hashes of the images for finding
+//! duplicates, takes effect since the next scan
+void
+ImageScanner::setHashing(bool aHashing)
+{
+	hashing_ = aHashing;
+}
+
+//! Returns true if the images are hashed during the scan
+bool
+ImageScanner::isHashing() const
+{
+	return hashing_;
+}
+
+//! Returns the number of the last scan
+int
+ImageScanner::generation() const
+{
+	return generation_;
+}
+
+//! Returns filters for the files the scanner is looking for
+/*!
+ * *.dat files are included also but only to indicate labeled images
+ */
+QStringList
+ImageScanner::nameFilters()
+{
+	QStringList filenameFilter;
+	filenameFilter <<
+		"*.jpeg" <<
+		"*.jpg" <<
+		"*.gif" <<
+		"*.png" <<
+		"*.bmp" <<
+		"*.tiff" <<
+		"*.dat"
+		;
+
+	return filenameFilter;
+}
+
+//! \brief Reads the size of the image from its header and the file size and
+//! modification time from the file system
+/*!
+ * Nothing is decoded, so it is cheap enough to be done for every image
+ * found during the search. It is safe to call this function from any thread.
+ */
+void
+ImageScanner::probeImage(Image &anImage)
+{
+	ImageArchive::stat(anImage.image_, &anImage.bytes_, &anImage.modified_);
+
+	ArchiveImageReader reader(anImage.image_);
+	anImage.size_ = reader.size();
+
+	if (anImage.labeled_)
+		anImage.annotation_ = annotationKey(ImageArchive::dataFile(anImage.image_));
+}
+
+//! \brief Returns a key of the labeling data file made of its size and
+//! modification time, 0 if there is no such file
+/*!
+ * The data files keep the whole pure_data dump, so they are never read
+ * just to tell whether they changed.
+ */
+quint64
+ImageScanner::annotationKey(const QString &aDataFile)
+{
+	qint64 size = 0;
+	uint modified = 0;
+	if (!ImageArchive::stat(aDataFile, &size, &modified)) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	return (quint64(modified) << 32) ^ quint64(size);
+}
+
+//! Returns case folded names of all the *.dat files among aFiles
+/*!
+ * \see dataFileFor(const QString &anImage)
+ *
+ * Looking for the data file in the set takes constant time instead of
+ * going through the whole directory listing for every image.
+ */
+QSet< QString >
+ImageScanner::dataFiles(const QStringList &aFiles)
+{
+	QSet< QString > result;
+	result.reserve(aFiles.count());
+
+	foreach (QString file, aFiles) {
+		if (file.endsWith(".dat", Qt::CaseInsensitive))
+			result.insert(removePath(file).toCaseFolded());
+	}
+
+	return result;
+}
+
+//! \brief Returns case folded name(without path) of the file with
+//! the labeling data for anImage
+/*!
+ * \see dataFiles(const QStringList &aFiles)
+ */
+QString
+ImageScanner::dataFileFor(const QString &anImage)
+{
+	QString labeled = alterFileName(anImage, "_labeled");
+	labeled = removePath(labeled);
+	labeled.append(".dat");
+
+	return labeled.toCaseFolded();
+}
+
+//! Scans the root_ directory with all the subdirectories(worker thread)
+/*!
+ * Directories are visited depth first in the alphabetical order, so the
+ * order of the images does not depend on whether they were taken from the
+ * manifest or not.
+ */
+void
+ImageScanner::run()
+{
+	QList< Image > batch;
+	QStringList dirs;
+	QTime timer;
+	timer.start();
+
+	DatasetManifest oldManifest;
+	oldManifest.load(root_);
+	DatasetManifest newManifest;
+	newManifest.setRoot(root_);
+
+	QStringList stack;
+	stack.append(QDir(root_).absolutePath());
+
+	while (!cancelled_ && !stack.isEmpty()) {
+		QString path = stack.takeLast();
+		uint modified = QFileInfo(path).lastModified().toTime_t();
+
+		ManifestDirectory directory = oldManifest.directory(path);
+		if (!oldManifest.contains(path) || modified != directory.modified_) {
+			QDir dir(path);
+			directory.modified_ = modified;
+			directory.images_.clear();
+			scanDirectory(dir, &directory.images_, &cancelled_);
+			directory.subdirs_ =
+				dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+			keepHashes(oldManifest.directory(path), &directory);
+		}
+		else {
+			QtConcurrent::blockingMap(
+				directory.images_,
+				UnlessCancelled(restatAnnotation, &cancelled_)
+				);
+		}
+
+		/* the rest of the directory was not read */
+		if (cancelled_)
+			break;
+
+		/* only the images hashed never before are read */
+		if (hashing_) {
+			QtConcurrent::blockingMap(
+				directory.images_,
+				UnlessCancelled(DuplicateFinder::hashImage, &cancelled_)
+				);
+		}
+		newManifest.setDirectory(path, directory);
+		dirs.append(path);
+
+		for (int i = directory.subdirs_.count() - 1; 0 <= i; i--)
+			stack.append(path + QString("/") + directory.subdirs_.at(i));
+
+		batch.append(directory.images_);
+		if (batch_size_ <= batch.count() ||
+			(!batch.isEmpty() && batch_interval_ < timer.elapsed()))
+		{
+			sendBatch(&batch, &dirs);
+			timer.restart();
+		}
+	}
+
+	/* the images found are listed even if the search was cancelled */
+	sendBatch(&batch, &dirs);
+
+	/* an incomplete manifest would hide the directories not visited */
+	if (!cancelled_)
+		newManifest.save();
+
+	emit searchFinished(generation_);
+}
+
+//! Adds all the images of aDir(not recursively) to anImages
+/*!
+ * \param[in] aDir a directory to list
+ * \param[out] anImages the list the images are appended to
+ * \param[in] aCancelled if it is set the headers are not read any more,
+ * so a huge directory on a slow storage does not delay the cancellation
+ */
+void
+ImageScanner::scanDirectory(
+	const QDir &aDir,
+	QList< Image > *anImages,
+	const QAtomicInt *aCancelled
+)
+{
+	QStringList listImages =
+		aDir.entryList(nameFilters(), QDir::Files);
+
+	QSet< QString > listData = dataFiles(listImages);
+
+	QList< Image > images;
+	foreach (QString file, listImages) {
+		/* ignoring segmented images and .dat files */
+		if (file.contains("_segmented", Qt::CaseInsensitive) ||
+			file.contains(".dat", Qt::CaseInsensitive)) {
+			continue;
+		}
+
+		Image newImage;
+		newImage.image_ = aDir.absoluteFilePath(file);
+		/* TODO: think about loading pascal files */
+		newImage.pas_ = 0;
+
+		/* checking if there is a data for current image */
+		newImage.labeled_ = listData.contains(dataFileFor(file));
+
+		images.append(newImage);
+	}
+
+	/* reading the headers in parallel, the file system is the bottleneck */
+	QtConcurrent::blockingMap(
+		images,
+		UnlessCancelled(probeImage, aCancelled)
+		);
+
+	anImages->append(images);
+}
+
+//! \brief Copies the hashes of the images which have not changed since
+//! the previous scan of the directory
+/*!
+ * \param[in] anOld the directory as it was during the previous scan
+ * \param[out] aNew the directory listed again
+ */
+void
+ImageScanner::keepHashes(
+	const ManifestDirectory &anOld,
+	ManifestDirectory *aNew
+)
+{
+	QHash< QString, int > old;
+	for (int i = 0; i < anOld.images_.count(); i++) {
+		const Image &image = anOld.images_.at(i);
+		if (image.content_hash_ || image.perceptual_hash_)
+			old.insert(image.image_, i);
+	}
+
+	if (old.isEmpty()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	for (int i = 0; i < aNew->images_.count(); i++) {
+		Image &image = aNew->images_[i];
+		int found = old.value(image.image_, -1);
+		if (found < 0 || anOld.images_.at(found).bytes_ != image.bytes_ ||
+			anOld.images_.at(found).modified_ != image.modified_)
+		{
+			continue;
+		}
+
+		image.content_hash_ = anOld.images_.at(found).content_hash_;
+		image.perceptual_hash_ = anOld.images_.at(found).perceptual_hash_;
+	}
+}
+
+//! Sends aBatch and aDirs to the GUI thread and clears them
+void
+ImageScanner::sendBatch(QList< Image > *aBatch, QStringList *aDirs)
+{
+	if (!aDirs->isEmpty()) {
+		emit directoriesFound(generation_, *aDirs);
+		aDirs->clear();
+	}
+
+	if (!aBatch->isEmpty()) {
+		emit imagesFound(generation_, *aBatch);
+		aBatch->clear();
+	}
+}
+
+/*
+ *
+ */
@@ -0,0 +1,154 @@
+/*!
+ * \file ImageScanner.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __IMAGESCANNER_H__
+#define __IMAGESCANNER_H__
+
+#include <QThread>
+#include <QString>
+#include <QStringList>
+#include <QSize>
+#include <QList>
+#include <QSet>
+#include <QDir>
+#include <QAtomicInt>
+#include <QMetaType>
+
+/* forward declarations */
+struct ManifestDirectory;
+
+//! Structure keeps path to the image and it's flags
+/*
+ * \see ImageLabeler::loadInfo(QString filename)
+ * \see ImageLabeler::loadPascalFile(QString aFilename, QString aPath)
+ *
+ * Image could be labeled before so you can load all the info about it
+ * using loadInfo(QString filename)
+ * pas_ means it was loaded from the file with PASCAL format
+ *
+ * size_, bytes_ and modified_ are read from the file header and the file
+ * system without decoding the image(see ImageScanner::probeImage()),
+ * size_ is invalid if the header could not be read.
+ * annotation_ identifies the version of the labeling data file by its size
+ * and modification time(see annotationKey()), 0 if the image is not labeled.
+ * content_hash_ and perceptual_hash_ are used to find duplicates, 0 if they
+ * are not computed(see DuplicateFinder::hashImage()).
+ */
+struct Image {
+	Image() :
+		labeled_(0),
+		pas_(0),
+		bytes_(0),
+		modified_(0),
+		annotation_(0),
+		content_hash_(0),
+		perceptual_hash_(0)
+	{}
+
+	QString image_;
+	bool labeled_;
+	bool pas_;
+	QSize size_;
+	qint64 bytes_;
+	uint modified_;
+	quint64 annotation_;
+	quint64 content_hash_;
+	quint64 perceptual_hash_;
+};
+
+Q_DECLARE_METATYPE(QList< Image >)
+
+//! \brief Thread looking for all the images in the directory recursively.
+/*!
+ * Found images are delivered in batches(see imagesFound()), so the first
+ * ones can be shown while the rest of a huge tree is still being scanned.
+ * The scan can be stopped at any moment by cancel().
+ *
+ * If it is asked to(see setHashing()) the scanner also computes the hashes
+ * DuplicateFinder needs, it takes reading every image once.
+ *
+ * Results of the complete scan are saved to the DatasetManifest at the
+ * root. Next time only the directories whose modification time has changed
+ * are listed again, the rest is taken from the manifest.
+ *
+ * Every scan gets its own generation number which is sent with every
+ * batch and with searchFinished(), so signals of a cancelled scan which are still in the event
+ * queue can be told apart from the new ones.
+ *
+ * \see ImageLabeler::loadImages()
+ */
+class ImageScanner : public QThread
+{
+	Q_OBJECT
+public:
+	ImageScanner(QObject *aParent = 0);
+	virtual ~ImageScanner();
+
+	void scan(const QString &aRoot);
+	void cancel();
+	bool isCancelled() const;
+	void setHashing(bool aHashing);
+	bool isHashing() const;
+	int generation() const;
+
+	static QStringList nameFilters();
+	static void probeImage(Image &anImage);
+	static QSet< QString > dataFiles(const QStringList &aFiles);
+	static QString dataFileFor(const QString &anImage);
+	static quint64 annotationKey(const QString &aDataFile);
+	static void scanDirectory(
+		const QDir &aDir,
+		QList< Image > *anImages,
+		const QAtomicInt *aCancelled = 0
+		);
+
+signals:
+	//! emitted from the worker thread for every batch of found images
+	void imagesFound(int aGeneration, const QList< Image > &anImages);
+	//! \brief emitted from the worker thread before every batch of images
+	//! for the directories visited since the previous batch
+	void directoriesFound(int aGeneration, const QStringList &aDirs);
+	//! \brief emitted from the worker thread after the last batch,
+	//! also if the scan was cancelled
+	void searchFinished(int aGeneration);
+
+protected:
+	void run();
+
+private:
+	void sendBatch(QList< Image > *aBatch, QStringList *aDirs);
+	static void keepHashes(
+		const ManifestDirectory &anOld,
+		ManifestDirectory *aNew
+		);
+
+	//! directory being scanned
+	QString root_;
+
+	//! non-zero if the scan should be stopped
+	QAtomicInt cancelled_;
+
+	//! \brief whether the images are hashed to find duplicates
+	//! \see setHashing(bool aHashing)
+	bool hashing_;
+
+	//! \brief number of the current scan
+	//! \see imagesFound(int aGeneration, const QList< Image > &anImages)
+	int generation_;
+
+	//! number of images after which the batch is sent
+	int batch_size_;
+
+	//! milliseconds after which the batch is sent even if it is not full
+	int batch_interval_;
+};
+
+#endif /* __IMAGESCANNER_H__ */
+
+/*
+ *
+ */
@@ -0,0 +1,247 @@
+/*
+ * ImageSorter.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ImageSorter.h"
+#include "ImageListModel.h"
+
+#include <QtConcurrentMap>
+#include <QtAlgorithms>
+#include <QThread>
+#include <QList>
+
+//! Structure keeps what the image is compared by
+struct SortKey {
+	SortKey() : primary_(0) {}
+
+	//! modification time, size or labeled flag, 0 for the natural order
+	quint64 primary_;
+	//! natural key of the path, compared if the primary keys are equal
+	QByteArray text_;
+};
+
+//! Compares the images by their keys, the ids break the ties
+struct KeyLess {
+	KeyLess(const QVector< SortKey > *aKeys) : keys_(aKeys) {}
+
+	bool operator()(int aFirst, int aSecond) const
+	{
+		const SortKey &first = keys_->at(aFirst);
+		const SortKey &second = keys_->at(aSecond);
+		if (first.primary_ != second.primary_)
+			return first.primary_ < second.primary_;
+
+		int result = qstrcmp(first.text_, second.text_);
+		if (result)
+			return result < 0;
+
+		return aFirst < aSecond;
+	}
+
+	const QVector< SortKey > *keys_;
+};
+
+//! A part of the work done by one thread
+struct SortChunk {
+	//! ids being sorted or merged
+	int *ids_;
+	//! where the merged ids go
+	int *merged_;
+	int begin_;
+	int middle_;
+	int end_;
+
+	const SortColumns *columns_;
+	const QVector< QByteArray > *directory_keys_;
+	QVector< SortKey > *keys_;
+	int order_;
+};
+
+//! Computes the keys of the images in the chunk(worker thread)
+static void
+computeKeys(SortChunk &aChunk)
+{
+	const SortColumns &columns = *aChunk.columns_;
+	for (int id = aChunk.begin_; id < aChunk.end_; id++) {
+		SortKey &key = (*aChunk.keys_)[id];
+
+		switch (aChunk.order_) {
+		case ImageSorter::ModifiedOrder:
+			key.primary_ = columns.modified_.at(id);
+			break;
+		case ImageSorter::SizeOrder:
+			key.primary_ = columns.bytes_.at(id);
+			break;
+		case ImageSorter::LabeledFirstOrder:
+			key.primary_ =
+				(columns.flags_.at(id) & ImageListModel::Labeled) ? 0 : 1;
+			break;
+		default:
+			key.primary_ = 0;
+		}
+
+		key.text_ =
+			aChunk.directory_keys_->at(columns.directory_.at(id)) +
+			ImageSorter::naturalKey(
+				columns.names_.mid(
+					columns.name_offset_.at(id),
+					columns.name_length_.at(id)
+					)
+				);
+	}
+}
+
+//! Sorts the ids of the chunk(worker thread)
+static void
+sortChunk(SortChunk &aChunk)
+{
+	qSort(
+		aChunk.ids_ + aChunk.begin_,
+		aChunk.ids_ + aChunk.end_,
+		KeyLess(aChunk.keys_)
+		);
+}
+
+//! Merges two sorted halves of the chunk into merged_(worker thread)
+static void
+mergeChunk(SortChunk &aChunk)
+{
+	KeyLess less(aChunk.keys_);
+	const int *ids = aChunk.ids_;
+	int *merged = aChunk.merged_ + aChunk.begin_;
+	int first = aChunk.begin_;
+	int second = aChunk.middle_;
+
+	while (first < aChunk.middle_ && second < aChunk.end_) {
+		if (less(ids[second], ids[first]))
+			*merged++ = ids[second++];
+		else
+			*merged++ = ids[first++];
+	}
+	while (first < aChunk.middle_)
+		*merged++ = ids[first++];
+	while (second < aChunk.end_)
+		*merged++ = ids[second++];
+}
+
+//! \brief Returns the key comparing the texts in the natural order
+//! (case insensitive, numbers by value)
+/*!
+ * Every number is encoded as '0', the number of its digits and the digits
+ * without leading zeros, so a shorter number is less than a longer one and
+ * numbers of the same length are compared digit by digit. The key contains
+ * no zero bytes and can be compared by qstrcmp().
+ */
+QByteArray
+ImageSorter::naturalKey(const QString &aText)
+{
+	QByteArray text = aText.toCaseFolded().toUtf8();
+	QByteArray key;
+	key.reserve(text.size() + 8);
+
+	int i = 0;
+	while (i < text.size()) {
+		if (text.at(i) < '0' || '9' < text.at(i)) {
+			key.append(text.at(i));
+			i++;
+			continue;
+		}
+
+		int begin = i;
+		while (i < text.size() && '0' <= text.at(i) && text.at(i) <= '9')
+			i++;
+		while (begin < i - 1 && '0' == text.at(begin))
+			begin++;
+
+		int length = qMin(i - begin, 255);
+		key.append('0');
+		key.append(char(length));
+		key.append(text.constData() + i - length, length);
+	}
+
+	return key;
+}
+
+//! Returns the ids of the images in anOrder(runs in a worker thread)
+/*!
+ * \param[in] aColumns the images to sort
+ * \param[in] anOrder one of the Order values
+ */
+QVector< int >
+ImageSorter::sort(const SortColumns &aColumns, int anOrder)
+{
+	int count = aColumns.directory_.count();
+	QVector< int > ids(count);
+	for (int i = 0; i < count; i++)
+		ids[i] = i;
+
+	if (ScanOrder == anOrder || count < 2) {
+		return ids;
+		/* NOTREACHED */
+	}
+
+	/* there are much fewer directories than images */
+	QVector< QByteArray > directoryKeys;
+	directoryKeys.reserve(aColumns.directories_.count());
+	foreach (const QString &directory, aColumns.directories_)
+		directoryKeys.append(naturalKey(directory));
+
+	QVector< SortKey > keys(count);
+	QVector< int > merged(count);
+
+	/* a few chunks per thread to even out the load */
+	int chunkCount = qMax(1, QThread::idealThreadCount()) * 4;
+	int chunkSize = qMax(1024, (count + chunkCount - 1) / chunkCount);
+
+	QList< SortChunk > chunks;
+	for (int begin = 0; begin < count; begin += chunkSize) {
+		SortChunk chunk;
+		chunk.ids_ = ids.data();
+		chunk.merged_ = merged.data();
+		chunk.begin_ = begin;
+		chunk.middle_ = qMin(begin + chunkSize, count);
+		chunk.end_ = chunk.middle_;
+		chunk.columns_ = &aColumns;
+		chunk.directory_keys_ = &directoryKeys;
+		chunk.keys_ = &keys;
+		chunk.order_ = anOrder;
+		chunks.append(chunk);
+	}
+
+	QtConcurrent::blockingMap(chunks, computeKeys);
+	QtConcurrent::blockingMap(chunks, sortChunk);
+
+	/* merging neighbouring chunks till there is only one */
+	while (1 < chunks.count()) {
+		QList< SortChunk > merges;
+		for (int i = 0; i < chunks.count(); i += 2) {
+			SortChunk merge = chunks.at(i);
+			if (i + 1 < chunks.count()) {
+				merge.middle_ = chunks.at(i).end_;
+				merge.end_ = chunks.at(i + 1).end_;
+			}
+			else
+				merge.middle_ = merge.end_;
+			merges.append(merge);
+		}
+
+		QtConcurrent::blockingMap(merges, mergeChunk);
+
+		/* the merged ids become the ids being merged next */
+		qSwap(ids, merged);
+		for (int i = 0; i < merges.count(); i++) {
+			merges[i].ids_ = ids.data();
+			merges[i].merged_ = merged.data();
+		}
+		chunks = merges;
+	}
+
+	return ids;
+}
+
+/*
+ *
+ */
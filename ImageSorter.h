@@ -0,0 +1,65 @@
+/*!
+ * \file ImageSorter.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __IMAGESORTER_H__
+#define __IMAGESORTER_H__
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+
+//! \brief Columns of the image list the order is computed from
+/*!
+ * All the members are implicitly shared, so taking them from the
+ * ImageListModel costs nothing and the model can be changed while
+ * the images are being sorted.
+ *
+ * \see ImageListModel::sortColumns()
+ */
+struct SortColumns {
+	QStringList directories_;
+	QVector< int > directory_;
+	QString names_;
+	QVector< int > name_offset_;
+	QVector< int > name_length_;
+	QVector< quint8 > flags_;
+	QVector< qint64 > bytes_;
+	QVector< uint > modified_;
+};
+
+//! \brief Sorts the images of the list in a worker thread.
+/*!
+ * A key is computed for every image beforehand(in parallel), so the
+ * comparisons are cheap: natural order compares bytes of the key where
+ * numbers are encoded so that "frame2" goes before "frame10".
+ * Then the images are sorted by chunks in parallel and the chunks are
+ * merged, also in parallel.
+ *
+ * \see ImageListModel::setOrder()
+ */
+class ImageSorter
+{
+public:
+	//! what the images are sorted by
+	enum Order {
+		ScanOrder,
+		NaturalOrder,
+		ModifiedOrder,
+		SizeOrder,
+		LabeledFirstOrder
+	};
+
+	static QByteArray naturalKey(const QString &aText);
+	static QVector< int > sort(const SortColumns &aColumns, int anOrder);
+};
+
+#endif /* __IMAGESORTER_H__ */
+
+/*
+ *
+ */
@@ -0,0 +1,264 @@
+/*
+ * Instrumentation.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "Instrumentation.h"
+
+#include <QHash>
+#include <QList>
+#include <QByteArray>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QtAlgorithms>
+
+//! Number of hits and misses of a cache
+struct LookupCount {
+	LookupCount() : hits_(0), misses_(0) {}
+
+	qint64 hits_;
+	qint64 misses_;
+};
+
+//! All the measurements reported so far
+struct MeasurementRegistry {
+	QMutex mutex_;
+	/* names in the order they were reported first */
+	QList< QByteArray > sample_names_;
+	QHash< QByteArray, SampleRing > samples_;
+	QList< QByteArray > cache_names_;
+	QHash< QByteArray, LookupCount > lookups_;
+};
+
+Q_GLOBAL_STATIC(MeasurementRegistry, registry)
+
+static QAtomicInt enabled(0);
+
+//! A constructor allocating the buffer for aCapacity values
+SampleRing::SampleRing(int aCapacity)
+	: samples_(qMax(1, aCapacity), 0.0)
+{
+	next_ = 0;
+	count_ = 0;
+}
+
+//! Adds the value overwriting the oldest one if the buffer is full
+void
+SampleRing::add(double aValue)
+{
+	samples_[next_] = aValue;
+	next_ = (next_ + 1) % samples_.count();
+	if (count_ < samples_.count())
+		count_++;
+}
+
+//! Drops all the values
+void
+SampleRing::clear()
+{
+	next_ = 0;
+	count_ = 0;
+}
+
+//! Returns the number of values kept
+int
+SampleRing::count() const
+{
+	return count_;
+}
+
+//! Returns the latest value, 0 if there are no values
+double
+SampleRing::last() const
+{
+	if (!count_) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	return samples_.at((next_ + samples_.count() - 1) % samples_.count());
+}
+
+//! Returns the value which aFraction(0..1) of the kept values do not exceed
+/*!
+ * e.g. percentile(0.95) is the 95th percentile. The values are copied and
+ * sorted, that's fine for a buffer of a hundred values read a few times
+ * per second.
+ */
+double
+SampleRing::percentile(double aFraction) const
+{
+	if (!count_) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	QVector< double > sorted = samples_.mid(0, count_);
+	qSort(sorted);
+
+	int index = qBound(0, int(aFraction * count_ + 0.5) - 1, count_ - 1);
+	return sorted.at(index);
+}
+
+//! \brief Turns recording on or off, the measurements recorded before
+//! are kept
+void
+Instrumentation::setEnabled(bool anEnabled)
+{
+	enabled = anEnabled ? 1 : 0;
+}
+
+//! Returns true if the measurements are being recorded
+bool
+Instrumentation::isEnabled()
+{
+	return 0 != int(enabled);
+}
+
+//! Adds aValue to the sample ring of aName
+/*!
+ * \param[in] aName name of the measurement, the unit is better to be
+ * mentioned in it(e.g. "paint, ms") as it is shown in the report as it is
+ */
+void
+Instrumentation::addSample(const char *aName, double aValue)
+{
+	if (!isEnabled()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	QByteArray name(aName);
+	QHash< QByteArray, SampleRing >::iterator ring =
+		measurements->samples_.find(name);
+	if (measurements->samples_.end() == ring) {
+		measurements->sample_names_.append(name);
+		ring = measurements->samples_.insert(name, SampleRing());
+	}
+
+	ring->add(aValue);
+}
+
+//! Counts a lookup of the cache of aCache name, aHit tells if it was found
+void
+Instrumentation::addLookup(const char *aCache, bool aHit)
+{
+	if (!isEnabled()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	QByteArray name(aCache);
+	QHash< QByteArray, LookupCount >::iterator count =
+		measurements->lookups_.find(name);
+	if (measurements->lookups_.end() == count) {
+		measurements->cache_names_.append(name);
+		count = measurements->lookups_.insert(name, LookupCount());
+	}
+
+	if (aHit)
+		count->hits_++;
+	else
+		count->misses_++;
+}
+
+//! Drops all the measurements
+void
+Instrumentation::clear()
+{
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	measurements->sample_names_.clear();
+	measurements->samples_.clear();
+	measurements->cache_names_.clear();
+	measurements->lookups_.clear();
+}
+
+//! Returns a copy of the sample ring of aName(empty if nothing was reported)
+SampleRing
+Instrumentation::samples(const char *aName)
+{
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	return measurements->samples_.value(QByteArray(aName));
+}
+
+//! Returns the share(0..1) of the lookups of aCache which were hits
+double
+Instrumentation::hitRate(const char *aCache)
+{
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	LookupCount count = measurements->lookups_.value(QByteArray(aCache));
+	qint64 total = count.hits_ + count.misses_;
+	if (!total) {
+		return 0;
+		/* NOTREACHED */
+	}
+
+	return double(count.hits_) / total;
+}
+
+//! \brief Returns a line per measurement: the latest value and the 95th
+//! percentile for samples, the hit rate and the number of lookups for caches
+QStringList
+Instrumentation::report()
+{
+	MeasurementRegistry *measurements = registry();
+	QMutexLocker locker(&measurements->mutex_);
+
+	QStringList lines;
+	foreach (QByteArray name, measurements->sample_names_) {
+		const SampleRing &ring = measurements->samples_[name];
+		lines.append(
+			QString("%1: %2 (p95 %3)").
+				arg(QString::fromLatin1(name)).
+				arg(ring.last(), 0, 'f', 1).
+				arg(ring.percentile(0.95), 0, 'f', 1)
+			);
+	}
+
+	foreach (QByteArray name, measurements->cache_names_) {
+		const LookupCount &count = measurements->lookups_[name];
+		qint64 total = count.hits_ + count.misses_;
+		lines.append(
+			QString("%1 hits: %2% of %3").
+				arg(QString::fromLatin1(name)).
+				arg(100.0 * count.hits_ / qMax(total, qint64(1)), 0, 'f', 1).
+				arg(total)
+			);
+	}
+
+	return lines;
+}
+
+//! A constructor starting the timer
+ScopedTiming::ScopedTiming(const char *aName)
+	: name_(aName)
+{
+	if (Instrumentation::isEnabled())
+		timer_.start();
+}
+
+//! A destructor reporting the time passed
+ScopedTiming::~ScopedTiming()
+{
+	if (timer_.isValid())
+		Instrumentation::addSample(name_, timer_.nsecsElapsed() / 1000000.0);
+}
+
+/*
+ *
+ */
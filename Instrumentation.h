@@ -0,0 +1,82 @@
+/*!
+ * \file Instrumentation.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __INSTRUMENTATION_H__
+#define __INSTRUMENTATION_H__
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QElapsedTimer>
+
+//! \brief The latest values of a measurement kept in a ring buffer
+/*!
+ * The oldest value is overwritten when the buffer is full, so the memory
+ * taken does not grow no matter how long the program runs.
+ */
+class SampleRing
+{
+public:
+	SampleRing(int aCapacity = 128);
+
+	void add(double aValue);
+	void clear();
+
+	int count() const;
+	double last() const;
+	double percentile(double aFraction) const;
+
+private:
+	QVector< double > samples_;
+	int next_;
+	int count_;
+};
+
+//! \brief Measurements reported by the modules of the program
+/*!
+ * Every measurement is identified by its name. Timings(or any other
+ * values) are kept in a SampleRing, cache lookups are counted as hits
+ * and misses. It is safe to report from any thread.
+ *
+ * Nothing is recorded while the instrumentation is disabled, so the calls
+ * can stay in the code for good: a disabled report costs a single check.
+ *
+ * \see ImageHolder::setHudVisible(bool)
+ */
+class Instrumentation
+{
+public:
+	static void setEnabled(bool anEnabled);
+	static bool isEnabled();
+
+	static void addSample(const char *aName, double aValue);
+	static void addLookup(const char *aCache, bool aHit);
+	static void clear();
+
+	static SampleRing samples(const char *aName);
+	static double hitRate(const char *aCache);
+	static QStringList report();
+};
+
+//! \brief Reports the time(in milliseconds) passed since the construction
+//! to the sample ring of aName when destroyed
+class ScopedTiming
+{
+public:
+	ScopedTiming(const char *aName);
+	~ScopedTiming();
+
+private:
+	const char *name_;
+	QElapsedTimer timer_;
+};
+
+#endif /* __INSTRUMENTATION_H__ */
+
+/*
+ *
+ */
@@ -0,0 +1,435 @@
+/*
+ * LabelIndex.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "LabelIndex.h"
+#include "ImageArchive.h"
+
+#include <QtConcurrentMap>
+#include <QXmlStreamReader>
+#include <QFile>
+#include <QDir>
+#include <QDataStream>
+#include <QDebug>
+
+/* "ILLI" - Image Labeler Label Index */
+static const quint32 indexMagic = 0x494c4c49;
+static const quint32 indexVersion = 1;
+
+//! Returns the area of the bounding box kept as "x;y;width;height;"
+static qint64
+boxArea(const QString &aData)
+{
+	QStringList values = aData.split(';', QString::SkipEmptyParts);
+	if (values.count() < 4)
+		return 0;
+
+	return qAbs(qint64(values.at(2).toInt()) * values.at(3).toInt());
+}
+
+//! \brief Returns the area of the polygon kept as "x1;y1;x2;y2;...",
+//! the shoelace formula is used
+static qint64
+polygonArea(const QString &aData)
+{
+	QStringList values = aData.split(';', QString::SkipEmptyParts);
+	int count = values.count() / 2;
+	if (count < 3)
+		return 0;
+
+	qint64 doubledArea = 0;
+	for (int i = 0; i < count; i++) {
+		int j = (i + 1) % count;
+		doubledArea +=
+			qint64(values.at(2 * i).toInt()) * values.at(2 * j + 1).toInt() -
+			qint64(values.at(2 * j).toInt()) * values.at(2 * i + 1).toInt();
+	}
+
+	return qAbs(doubledArea) / 2;
+}
+
+//! A constructor of the empty index
+LabelIndex::LabelIndex()
+{
+
+}
+
+//! Adds the index of the dataset root to this one
+/*!
+ * \param[in] aRoot a path to the dataset root
+ *
+ * Returns false if there is no index file or it can not be read.
+ */
+bool
+LabelIndex::load(const QString &aRoot)
+{
+	QDir root(aRoot);
+	QFile file(indexFile(aRoot));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	stream >> magic >> version;
+	if (indexMagic != magic || indexVersion != version) {
+		qDebug() << "LabelIndex::load: unknown format of " <<
+			file.fileName();
+		return false;
+		/* NOTREACHED */
+	}
+
+	quint32 imageCount = 0;
+	stream >> imageCount;
+
+	LabelIndex loaded;
+	for (quint32 i = 0; i < imageCount && QDataStream::Ok == stream.status(); i++) {
+		QString path;
+		IndexedImage indexed;
+		quint32 labelCount = 0;
+		stream >> path >> indexed.annotation_ >> labelCount;
+
+		for (quint32 j = 0; j < labelCount; j++) {
+			QString label;
+			LabelStats stats;
+			stream >> label >> stats.objects_ >> stats.area_;
+			indexed.labels_.insert(label, stats);
+		}
+
+		loaded.setImage(
+			QDir::cleanPath(root.absoluteFilePath(path)),
+			indexed
+			);
+	}
+
+	if (QDataStream::Ok != stream.status()) {
+		qDebug() << "LabelIndex::load: " << file.fileName() <<
+			" is corrupted";
+		return false;
+		/* NOTREACHED */
+	}
+
+	merge(loaded);
+	return true;
+}
+
+//! Writes the images lying inside aRoot to the index file of the root
+/*!
+ * The file is rewritten in place for the same reason the manifest is.
+ * \see DatasetManifest::save()
+ */
+bool
+LabelIndex::save(const QString &aRoot) const
+{
+	QDir root(aRoot);
+	QFile file(indexFile(aRoot));
+	if (aRoot.isEmpty() || !file.open(QIODevice::WriteOnly)) {
+		qDebug() << "LabelIndex::save: can not write to " << aRoot;
+		return false;
+		/* NOTREACHED */
+	}
+
+	QString prefix = root.absolutePath() + QString("/");
+	QList< QString > paths;
+	QHash< QString, IndexedImage >::const_iterator i;
+	for (i = images_.constBegin(); i != images_.constEnd(); ++i) {
+		if (i.key().startsWith(prefix))
+			paths.append(i.key());
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << indexMagic << indexVersion << quint32(paths.count());
+
+	foreach (const QString &path, paths) {
+		const IndexedImage &indexed = images_[path];
+		stream << root.relativeFilePath(path) << indexed.annotation_ <<
+			quint32(indexed.labels_.count());
+
+		QHash< QString, LabelStats >::const_iterator label;
+		for (label = indexed.labels_.constBegin();
+			label != indexed.labels_.constEnd();
+			++label)
+		{
+			stream << label.key() << label.value().objects_ <<
+				label.value().area_;
+		}
+	}
+
+	if (QDataStream::Ok != stream.status()) {
+		qDebug() << "LabelIndex::save: can not write " << file.fileName();
+		file.remove();
+		return false;
+		/* NOTREACHED */
+	}
+
+	return true;
+}
+
+//! Removes all the images
+void
+LabelIndex::clear()
+{
+	images_.clear();
+	inverted_.clear();
+}
+
+//! Adds all the images of anIndex replacing the ones this index has
+void
+LabelIndex::merge(const LabelIndex &anIndex)
+{
+	QHash< QString, IndexedImage >::const_iterator i;
+	for (i = anIndex.images_.constBegin(); i != anIndex.images_.constEnd(); ++i)
+		setImage(i.key(), i.value());
+}
+
+//! Returns true if the labels of anImage are in the index
+bool
+LabelIndex::contains(const QString &anImage) const
+{
+	return images_.contains(anImage);
+}
+
+//! Returns the labels of anImage
+IndexedImage
+LabelIndex::image(const QString &anImage) const
+{
+	return images_.value(anImage);
+}
+
+//! Replaces the labels of anImage
+/*!
+ * \param[in] anImage an absolute path to the image
+ * \param[in] anIndexed labels found in the labeling data of the image
+ */
+void
+LabelIndex::setImage(const QString &anImage, const IndexedImage &anIndexed)
+{
+	removeImage(anImage);
+
+	images_.insert(anImage, anIndexed);
+	foreach (const QString &label, anIndexed.labels_.keys())
+		inverted_[label].insert(anImage);
+}
+
+//! Removes the labels of anImage from the index
+void
+LabelIndex::removeImage(const QString &anImage)
+{
+	QHash< QString, IndexedImage >::iterator found = images_.find(anImage);
+	if (found == images_.end()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	foreach (const QString &label, found.value().labels_.keys()) {
+		QHash< QString, QSet< QString > >::iterator images =
+			inverted_.find(label);
+		if (images == inverted_.end())
+			continue;
+
+		images.value().remove(anImage);
+		if (images.value().isEmpty())
+			inverted_.erase(images);
+	}
+
+	images_.erase(found);
+}
+
+//! Returns names of all the labels used in the dataset sorted alphabetically
+QStringList
+LabelIndex::labels() const
+{
+	QStringList result = inverted_.keys();
+	result.sort();
+
+	return result;
+}
+
+//! Returns absolute paths to all the images containing aLabel
+QSet< QString >
+LabelIndex::images(const QString &aLabel) const
+{
+	return inverted_.value(aLabel);
+}
+
+//! Returns the name of the index file in the dataset root
+QString
+LabelIndex::fileName()
+{
+	return QString(".ImageLabeler.labels");
+}
+
+//! Returns the path to the index file of the dataset root
+/*!
+ * \param[in] aRoot a path to the folder or "archive.tar!" for the archive
+ *
+ * The archive can not be written to, its index file is
+ * "archive.tar.labels/.ImageLabeler.labels" next to the labeling data
+ * (see ImageArchive::dataFile()).
+ */
+QString
+LabelIndex::indexFile(const QString &aRoot)
+{
+	QString path = QDir(aRoot).absoluteFilePath(fileName());
+	QString archive;
+	if (ImageArchive::splitPath(path, &archive, 0))
+		return archive + QString(".labels/") + fileName();
+
+	return path;
+}
+
+//! Reads the labels and objects from the labeling data
+/*!
+ * \param[in] aData contents of the file saved by ImageLabeler::saveAllInfo()
+ *
+ * The data is read as a stream and pure_data is skipped, so the whole
+ * document is never built in memory. Objects with an unknown label id
+ * are indexed under the id itself. annotation_ is left 0, it is up to
+ * the caller who knows the file(see ImageScanner::annotationKey()).
+ */
+IndexedImage
+LabelIndex::indexData(const QByteArray &aData)
+{
+	IndexedImage result;
+
+	QHash< int, QString > names;
+	QHash< int, LabelStats > stats;
+
+	QXmlStreamReader reader(aData);
+	while (!reader.atEnd()) {
+		reader.readNext();
+		if (!reader.isStartElement())
+			continue;
+
+		QStringRef tag = reader.name();
+		if (tag == QLatin1String("pure_data")) {
+			reader.skipCurrentElement();
+			continue;
+		}
+
+		bool isLabel = tag == QLatin1String("label");
+		bool isBox = tag == QLatin1String("bbox");
+		bool isPoly = tag == QLatin1String("poly");
+		if (!isLabel && !isBox && !isPoly)
+			continue;
+
+		bool ok = 0;
+		int id = reader.attributes().value(QLatin1String("id")).toString().toInt(&ok, 10);
+		QString text = reader.readElementText();
+		if (!ok || id < 0)
+			continue;
+
+		if (isLabel) {
+			/* the main label is saved with the mark */
+			text.remove(" #main");
+			names.insert(id, text.trimmed());
+			continue;
+		}
+
+		LabelStats &label = stats[id];
+		label.objects_++;
+		label.area_ += isBox ? boxArea(text) : polygonArea(text);
+	}
+
+	if (reader.hasError()) {
+		qDebug() << "LabelIndex::indexData: " << reader.errorString();
+	}
+
+	QHash< int, LabelStats >::const_iterator i;
+	for (i = stats.constBegin(); i != stats.constEnd(); ++i) {
+		LabelStats &label =
+			result.labels_[names.value(i.key(), QString::number(i.key()))];
+		label.objects_ += i.value().objects_;
+		label.area_ += i.value().area_;
+	}
+
+	return result;
+}
+
+//! Reads the labels and objects from the labeling data file
+/*!
+ * It is safe to call this function from any thread.
+ * \see indexData(const QByteArray &aData)
+ */
+IndexedImage
+LabelIndex::indexDataFile(const QString &aDataFile)
+{
+	/* taken before reading, a file changed meanwhile is read again later */
+	quint64 annotation = ImageScanner::annotationKey(aDataFile);
+
+	QFile file(aDataFile);
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug() << "LabelIndex::indexDataFile: can not read " << aDataFile;
+		return IndexedImage();
+		/* NOTREACHED */
+	}
+
+	IndexedImage result = indexData(file.readAll());
+	result.annotation_ = annotation;
+	return result;
+}
+
+//! Brings the index of the dataset root up to date(worker thread)
+/*!
+ * \param[in] aRoot a path to the dataset root
+ * \param[in] aLabeled all the labeled images found inside aRoot
+ *
+ * Images whose labeling data has the same key as the one in the index
+ * file are taken from it, the rest of data files are read in parallel.
+ * Images which are not labeled any more are dropped.
+ */
+LabelIndex
+LabelIndex::build(
+	const QString &aRoot,
+	const QList< Image > &aLabeled
+)
+{
+	LabelIndex stored;
+	stored.load(aRoot);
+
+	LabelIndex index;
+	QStringList staleImages;
+	QStringList staleFiles;
+	foreach (const Image &image, aLabeled) {
+		if (image.pas_)
+			continue;
+
+		if (image.annotation_ && stored.contains(image.image_) &&
+			image.annotation_ == stored.image(image.image_).annotation_)
+		{
+			index.setImage(image.image_, stored.image(image.image_));
+			continue;
+		}
+
+		staleImages.append(image.image_);
+		staleFiles.append(ImageArchive::dataFile(image.image_));
+	}
+
+	QList< IndexedImage > indexed =
+		QtConcurrent::blockingMapped< QList< IndexedImage > >(
+			staleFiles,
+			&LabelIndex::indexDataFile
+			);
+	for (int i = 0; i < indexed.count(); i++)
+		index.setImage(staleImages.at(i), indexed.at(i));
+
+	if (!staleFiles.isEmpty() ||
+		stored.images_.count() != index.images_.count())
+	{
+		index.save(aRoot);
+	}
+
+	return index;
+}
+
+/*
+ *
+ */
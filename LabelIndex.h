@@ -0,0 +1,96 @@
+/*!
+ * \file LabelIndex.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __LABELINDEX_H__
+#define __LABELINDEX_H__
+
+#include "ImageScanner.h"
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QList>
+#include <QHash>
+#include <QSet>
+
+//! Structure keeps how much of the image is taken by one label
+/*
+ * area_ is a sum of the areas of all the objects in pixels, overlapping
+ * objects are counted twice.
+ */
+struct LabelStats {
+	LabelStats() : objects_(0), area_(0) {}
+
+	int objects_;
+	qint64 area_;
+};
+
+//! Structure keeps the labels found in the labeling data of one image
+/*
+ * annotation_ is the key of the data file the labels were read from
+ * (see ImageScanner::annotationKey()), the entry is outdated if it differs
+ * from the one the scanner found.
+ */
+struct IndexedImage {
+	IndexedImage() : annotation_(0) {}
+
+	quint64 annotation_;
+	QHash< QString, LabelStats > labels_;
+};
+
+//! \brief Index of the labels used in the labeling data of the dataset.
+/*!
+ * Keeps the labels of every labeled image and the inverted index from
+ * the label name to the images containing it, so the image list can be
+ * filtered by label without opening any file.
+ *
+ * The index of each dataset root is kept in a file next to the
+ * DatasetManifest, paths in it are relative to the root. The root of the
+ * archive is "archive.tar!", its index file is kept in the sidecar
+ * directory with the labeling data(see indexFile()). Only the data files
+ * which changed since the last time are read again(see build()).
+ *
+ * \see ImageLabeler::label_index_
+ */
+class LabelIndex
+{
+public:
+	LabelIndex();
+
+	bool load(const QString &aRoot);
+	bool save(const QString &aRoot) const;
+	void clear();
+	void merge(const LabelIndex &anIndex);
+	bool contains(const QString &anImage) const;
+	IndexedImage image(const QString &anImage) const;
+	void setImage(const QString &anImage, const IndexedImage &anIndexed);
+	void removeImage(const QString &anImage);
+	QStringList labels() const;
+	QSet< QString > images(const QString &aLabel) const;
+
+	static QString fileName();
+	static QString indexFile(const QString &aRoot);
+	static IndexedImage indexData(const QByteArray &aData);
+	static IndexedImage indexDataFile(const QString &aDataFile);
+	static LabelIndex build(
+		const QString &aRoot,
+		const QList< Image > &aLabeled
+		);
+
+private:
+	//! labels of the images keyed by absolute path to the image
+	QHash< QString, IndexedImage > images_;
+
+	//! absolute paths to the images containing the label keyed by label name
+	QHash< QString, QSet< QString > > inverted_;
+};
+
+#endif /* __LABELINDEX_H__ */
+
+/*
+ *
+ */
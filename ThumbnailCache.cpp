@@ -0,0 +1,441 @@
+/*
+ * ThumbnailCache.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "ThumbnailCache.h"
+#include "ImageArchive.h"
+#include "Instrumentation.h"
+
+#include <QtConcurrentRun>
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QBuffer>
+#include <QDataStream>
+#include <QMap>
+#include <QCryptographicHash>
+#include <QThread>
+#include <QDebug>
+
+/* "ILTP" - Image Labeler Thumbnail Pack */
+static const quint32 packMagic = 0x494c5450;
+static const quint32 packVersion = 1;
+/* magic and version */
+static const qint64 packHeaderSize = 8;
+/* key and length of the blob */
+static const qint64 recordHeaderSize = 12;
+/* more than enough for the visible rows of the list */
+static const int maxRequests = 256;
+
+//! \brief Decodes the image reduced to aSize and encodes it to jpeg
+//! (runs in a worker thread)
+static QByteArray
+generateThumbnail(const QString &aPath, int aSize)
+{
+	ArchiveImageReader reader(aPath);
+	QSize size = reader.size();
+
+	/* decoders like libjpeg scale during decoding which is much faster */
+	if (size.isValid() &&
+		reader.supportsOption(QImageIOHandler::ScaledSize))
+	{
+		size.scale(aSize, aSize, Qt::KeepAspectRatio);
+		reader.setScaledSize(size.expandedTo(QSize(1, 1)));
+	}
+
+	QImage image = reader.read();
+	if (image.isNull()) {
+		return QByteArray();
+		/* NOTREACHED */
+	}
+
+	if (aSize < image.width() || aSize < image.height()) {
+		image = image.scaled(
+			aSize,
+			aSize,
+			Qt::KeepAspectRatio,
+			Qt::SmoothTransformation
+			);
+	}
+
+	QByteArray data;
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	image.save(&buffer, "jpg", 80);
+
+	return data;
+}
+
+//! A constructor initializing some variables
+ThumbnailCache::ThumbnailCache(QObject *aParent)
+	: QObject(aParent)
+{
+	thumbnail_size_ = 64;
+	/* about 40 thousand thumbnails */
+	max_pack_size_ = 128 * 1024 * 1024;
+	recent_.setMaxCost(1024);
+}
+
+//! A destructor closing the pack file
+ThumbnailCache::~ThumbnailCache()
+{
+	close();
+}
+
+//! Opens(or creates) the pack file and reads the index out of it
+/*!
+ * \param[in] aPackPath a path to the pack file
+ *
+ * If the pack is corrupted or has an unknown version it is truncated.
+ */
+bool
+ThumbnailCache::open(const QString &aPackPath)
+{
+	close();
+
+	pack_.setFileName(aPackPath);
+	if (!pack_.open(QIODevice::ReadWrite)) {
+		qDebug() << "ThumbnailCache::open: can not open " << aPackPath;
+		return false;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&pack_);
+	stream.setVersion(QDataStream::Qt_4_6);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	stream >> magic >> version;
+
+	if (packMagic != magic || packVersion != version) {
+		pack_.resize(0);
+		pack_.seek(0);
+		stream << packMagic << packVersion;
+		return true;
+		/* NOTREACHED */
+	}
+
+	/* only record headers are read, blobs are skipped */
+	qint64 offset = packHeaderSize;
+	while (offset + recordHeaderSize <= pack_.size()) {
+		pack_.seek(offset);
+		quint64 key = 0;
+		quint32 length = 0;
+		stream >> key >> length;
+
+		if (pack_.size() < offset + recordHeaderSize + length)
+			break;
+
+		index_.insert(key, offset);
+		offset += recordHeaderSize + length;
+	}
+
+	/* cutting the record which was not written completely */
+	if (offset < pack_.size())
+		pack_.resize(offset);
+
+	if (max_pack_size_ < pack_.size())
+		compact();
+
+	return true;
+}
+
+//! Closes the pack file and drops all the requests
+void
+ThumbnailCache::close()
+{
+	clearRequests();
+	index_.clear();
+	recent_.clear();
+	failed_.clear();
+
+	if (pack_.isOpen())
+		pack_.close();
+}
+
+//! Returns width and height of the thumbnail
+int
+ThumbnailCache::thumbnailSize() const
+{
+	return thumbnail_size_;
+}
+
+//! Returns the thumbnail of the image or null image if it is not ready
+/*!
+ * \param[in] aPath an absolute path to the image
+ * \param[in] aBytes size of the image file
+ * \param[in] aModified modification time of the image file
+ *
+ * Missing thumbnail is requested,
+ * see request(const QString &aPath, qint64 aBytes, uint aModified),
+ * unless the image failed to decode before.
+ */
+QImage
+ThumbnailCache::thumbnail(const QString &aPath, qint64 aBytes, uint aModified)
+{
+	quint64 thumbnailKey = key(aPath, aBytes, aModified);
+
+	QImage *cached = recent_.object(thumbnailKey);
+	Instrumentation::addLookup("thumbnail memory cache", cached);
+	if (cached)
+		return *cached;
+
+	if (index_.contains(thumbnailKey)) {
+		QImage image = readThumbnail(thumbnailKey);
+		if (!image.isNull()) {
+			Instrumentation::addLookup("thumbnail pack", true);
+			recent_.insert(thumbnailKey, new QImage(image));
+			return image;
+			/* NOTREACHED */
+		}
+	}
+
+	Instrumentation::addLookup("thumbnail pack", false);
+	if (!failed_.contains(thumbnailKey))
+		request(aPath, aBytes, aModified);
+	return QImage();
+}
+
+//! Puts the image to the queue of the thumbnails to generate
+/*!
+ * The latest request is served first, so the images the user is looking
+ * at right now get their thumbnails before the rest. Only a limited number
+ * of the latest requests is kept.
+ */
+void
+ThumbnailCache::request(const QString &aPath, qint64 aBytes, uint aModified)
+{
+	if (generating_.contains(aPath)) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QPair< QString, quint64 > request(aPath, key(aPath, aBytes, aModified));
+	requests_.removeAll(request);
+	requests_.append(request);
+
+	/* the oldest requests are for the rows scrolled away long ago */
+	while (maxRequests < requests_.count())
+		requests_.removeFirst();
+
+	generateNext();
+}
+
+//! Drops all the thumbnails waiting for generation
+/*!
+ * Generations which are already running will be finished.
+ */
+void
+ThumbnailCache::clearRequests()
+{
+	requests_.clear();
+}
+
+//! Starts generating the next requested thumbnails if there are free threads
+void
+ThumbnailCache::generateNext()
+{
+	while (!requests_.isEmpty() &&
+		generating_.count() < QThread::idealThreadCount())
+	{
+		QPair< QString, quint64 > request = requests_.takeLast();
+		QString path = request.first;
+
+		QFutureWatcher< QByteArray > *watcher =
+			new QFutureWatcher< QByteArray >(this);
+		watcher->setProperty("path", path);
+		watcher->setProperty("key", request.second);
+		connect(
+			watcher,
+			SIGNAL(finished()),
+			this,
+			SLOT(onThumbnailGenerated())
+			);
+		generating_.insert(path, watcher);
+
+		watcher->setFuture(
+			QtConcurrent::run(generateThumbnail, path, thumbnail_size_)
+			);
+	}
+}
+
+//! \brief A slot member being called when the worker thread
+//! finished generating the thumbnail
+void
+ThumbnailCache::onThumbnailGenerated()
+{
+	QFutureWatcher< QByteArray > *watcher =
+		static_cast< QFutureWatcher< QByteArray > * >(sender());
+	if (!watcher) {
+		return;
+		/* NOTREACHED */
+	}
+
+	QString path = watcher->property("path").toString();
+	quint64 thumbnailKey = watcher->property("key").toULongLong();
+	QByteArray data = watcher->result();
+	generating_.remove(path);
+	watcher->deleteLater();
+
+	generateNext();
+
+	QImage image = QImage::fromData(data, "jpg");
+	if (image.isNull()) {
+		failed_.insert(thumbnailKey);
+		return;
+		/* NOTREACHED */
+	}
+
+	writeThumbnail(thumbnailKey, data);
+	recent_.insert(thumbnailKey, new QImage(image));
+
+	emit thumbnailReady(path, image);
+}
+
+//! Returns the key of the thumbnail(hash of path, mtime and size)
+/*!
+ * The size and the time are the ones the image list got during the search
+ * (see ImageScanner::probeImage()), the file is not touched here.
+ */
+quint64
+ThumbnailCache::key(const QString &aPath, qint64 aBytes, uint aModified)
+{
+	QString id = QString("%1|%2|%3").
+		arg(aPath).
+		arg(aModified).
+		arg(aBytes);
+
+	QByteArray hash = QCryptographicHash::hash(
+		id.toUtf8(),
+		QCryptographicHash::Md5
+		);
+
+	quint64 thumbnailKey = 0;
+	for (int i = 0; i < 8; i++)
+		thumbnailKey = (thumbnailKey << 8) | quint8(hash.at(i));
+
+	return thumbnailKey;
+}
+
+//! Reads the thumbnail from the pack file
+QImage
+ThumbnailCache::readThumbnail(quint64 aKey)
+{
+	if (!pack_.isOpen() || !pack_.seek(index_.value(aKey))) {
+		return QImage();
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&pack_);
+	stream.setVersion(QDataStream::Qt_4_6);
+	quint64 key = 0;
+	quint32 length = 0;
+	stream >> key >> length;
+
+	if (key != aKey) {
+		return QImage();
+		/* NOTREACHED */
+	}
+
+	return QImage::fromData(pack_.read(length), "jpg");
+}
+
+//! Appends the thumbnail to the end of the pack file
+void
+ThumbnailCache::writeThumbnail(quint64 aKey, const QByteArray &aData)
+{
+	if (!pack_.isOpen() || index_.contains(aKey)) {
+		return;
+		/* NOTREACHED */
+	}
+
+	qint64 offset = pack_.size();
+	pack_.seek(offset);
+
+	QDataStream stream(&pack_);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << aKey << quint32(aData.size());
+	pack_.write(aData);
+	pack_.flush();
+
+	index_.insert(aKey, offset);
+
+	if (max_pack_size_ < pack_.size())
+		compact();
+}
+
+//! Drops the oldest thumbnails leaving the pack half of the maximal size
+/*!
+ * Records are appended, so the oldest ones are at the beginning of the pack.
+ * The newest records are copied to a new pack which replaces the old one.
+ * Thumbnails of the images changed since are dropped this way too.
+ */
+void
+ThumbnailCache::compact()
+{
+	/* records in the order they were written */
+	QMap< qint64, quint64 > records;
+	QHash< quint64, qint64 >::const_iterator record = index_.constBegin();
+	for (; record != index_.constEnd(); ++record)
+		records.insert(record.value(), record.key());
+
+	qint64 keep = max_pack_size_ / 2;
+	qint64 first = pack_.size();
+	QMap< qint64, quint64 >::const_iterator last = records.constEnd();
+	while (last != records.constBegin()) {
+		--last;
+		if (keep < pack_.size() - last.key())
+			break;
+		first = last.key();
+	}
+
+	QString packPath = pack_.fileName();
+	QFile compacted(packPath + QString(".new"));
+	if (!compacted.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug() << "ThumbnailCache::compact: can not create " <<
+			compacted.fileName();
+		return;
+		/* NOTREACHED */
+	}
+
+	QDataStream stream(&compacted);
+	stream.setVersion(QDataStream::Qt_4_6);
+	stream << packMagic << packVersion;
+
+	pack_.seek(first);
+	while (!pack_.atEnd())
+		compacted.write(pack_.read(1024 * 1024));
+	compacted.close();
+
+	QHash< quint64, qint64 > index;
+	QMap< qint64, quint64 >::const_iterator kept = records.lowerBound(first);
+	for (; kept != records.constEnd(); ++kept)
+		index.insert(kept.value(), kept.key() - first + packHeaderSize);
+
+	pack_.close();
+	if (!QFile::remove(packPath)) {
+		qDebug() << "ThumbnailCache::compact: can not replace " << packPath;
+		compacted.remove();
+		pack_.open(QIODevice::ReadWrite);
+		return;
+		/* NOTREACHED */
+	}
+
+	/* starting with the empty pack rather than without any */
+	if (!compacted.rename(packPath)) {
+		qDebug() << "ThumbnailCache::compact: can not rename " <<
+			compacted.fileName();
+		open(packPath);
+		return;
+		/* NOTREACHED */
+	}
+
+	index_ = index;
+	pack_.open(QIODevice::ReadWrite);
+}
+
+/*
+ *
+ */
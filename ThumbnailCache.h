@@ -0,0 +1,100 @@
+/*!
+ * \file ThumbnailCache.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __THUMBNAILCACHE_H__
+#define __THUMBNAILCACHE_H__
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QList>
+#include <QCache>
+#include <QFutureWatcher>
+
+//! \brief Persistent cache of image thumbnails.
+/*!
+ * Thumbnails are kept as small jpeg blobs in one pack file, so browsing
+ * a big folder does not create thousands of small files. A thumbnail is
+ * keyed by the path, the modification time and the size of the image,
+ * so changed images get new thumbnails automatically. The caller passes
+ * the time and the size it already knows, nothing is asked from the file
+ * system on lookup. The pack is compacted when it grows too big, the
+ * oldest thumbnails are dropped(see compact()).
+ *
+ * Missing thumbnails are generated by the global thread pool. Only the
+ * latest requests are served(see request(const QString &aPath)), so the
+ * caller should ask only for the images which are visible at the moment.
+ *
+ * \see ImageListModel::data()
+ */
+class ThumbnailCache : public QObject
+{
+	Q_OBJECT
+public:
+	ThumbnailCache(QObject *aParent = 0);
+	virtual ~ThumbnailCache();
+
+	bool open(const QString &aPackPath);
+	void close();
+	int thumbnailSize() const;
+	QImage thumbnail(const QString &aPath, qint64 aBytes, uint aModified);
+	void request(const QString &aPath, qint64 aBytes, uint aModified);
+	void clearRequests();
+
+signals:
+	//! emitted when the thumbnail requested before is ready
+	void thumbnailReady(const QString &aPath, const QImage &aThumbnail);
+
+private slots:
+	void onThumbnailGenerated();
+
+private:
+	static quint64 key(const QString &aPath, qint64 aBytes, uint aModified);
+	QImage readThumbnail(quint64 aKey);
+	void writeThumbnail(quint64 aKey, const QByteArray &aData);
+	void compact();
+	void generateNext();
+
+	//! file with all the thumbnails
+	QFile pack_;
+
+	//! offsets of thumbnails in pack_
+	QHash< quint64, qint64 > index_;
+
+	//! recently used thumbnails
+	QCache< quint64, QImage > recent_;
+
+	//! \brief paths and keys of the thumbnails waiting for generation,
+	//! the last one is served first
+	//! \see request(const QString &aPath, qint64 aBytes, uint aModified)
+	QList< QPair< QString, quint64 > > requests_;
+
+	//! \brief keys of the images which could not be decoded, they are not
+	//! requested again
+	QSet< quint64 > failed_;
+
+	//! generations running at the moment, keyed by path
+	QHash< QString, QFutureWatcher< QByteArray > * > generating_;
+
+	//! width and height of the thumbnail
+	int thumbnail_size_;
+
+	//! \brief size of pack_ it is compacted at
+	//! \see compact()
+	qint64 max_pack_size_;
+};
+
+#endif /* __THUMBNAILCACHE_H__ */
+
+/*
+ *
+ */
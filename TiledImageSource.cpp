@@ -0,0 +1,139 @@
+/*
+ * TiledImageSource.cpp
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#include "TiledImageSource.h"
+#include "ImageArchive.h"
+
+#include <QImageReader>
+#include <QImageIOHandler>
+#include <QDebug>
+
+//! A constructor of the invalid source
+TiledImageSource::TiledImageSource()
+{
+	supports_regions_ = 0;
+	supports_scaling_ = 0;
+}
+
+//! A constructor reading the header of the image
+/*!
+ * \param[in] aPath a path to the image file
+ */
+TiledImageSource::TiledImageSource(const QString &aPath)
+{
+	path_ = aPath;
+	supports_regions_ = 0;
+	supports_scaling_ = 0;
+
+	ArchiveImageReader reader(aPath);
+	if (!reader.canRead()) {
+		return;
+		/* NOTREACHED */
+	}
+
+	size_ = reader.size();
+	format_ = reader.format();
+	supports_scaling_ = reader.supportsOption(QImageIOHandler::ScaledSize);
+	supports_regions_ =
+		reader.supportsOption(QImageIOHandler::ClipRect) &&
+		supports_scaling_;
+}
+
+//! Returns true if the header was read successfully
+bool
+TiledImageSource::isValid() const
+{
+	return size_.isValid() && !size_.isEmpty();
+}
+
+//! Returns true if regions can be decoded without decoding the whole image
+bool
+TiledImageSource::supportsRegions() const
+{
+	return supports_regions_;
+}
+
+//! \brief Returns true if the decoder can produce a reduced image much faster
+//! than the full one(libjpeg DCT scaling for instance)
+bool
+TiledImageSource::supportsScaling() const
+{
+	return supports_scaling_;
+}
+
+//! Returns a path to the image file
+QString
+TiledImageSource::path() const
+{
+	return path_;
+}
+
+//! Returns the size of the whole image
+QSize
+TiledImageSource::size() const
+{
+	return size_;
+}
+
+//! Returns the format of the image(like "jpeg")
+QByteArray
+TiledImageSource::format() const
+{
+	return format_;
+}
+
+//! Decodes the region of the image
+/*!
+ * \param[in] aRect a region in coordinates of the whole image
+ * \param[in] aScaledSize a size the region should be scaled to,
+ * the decoder(libjpeg for instance) can make this scaling during decoding
+ * which is much faster than decoding the full resolution
+ *
+ * It is safe to call this function from any thread.
+ */
+QImage
+TiledImageSource::decode(
+	const QRect &aRect,
+	const QSize &aScaledSize
+) const
+{
+	QRect rect = aRect.intersected(QRect(QPoint(0, 0), size_));
+	if (rect.isEmpty()) {
+		return QImage();
+		/* NOTREACHED */
+	}
+
+	ArchiveImageReader reader(path_, format_);
+	if (rect != QRect(QPoint(0, 0), size_))
+		reader.setClipRect(rect);
+	if (aScaledSize.isValid() && aScaledSize != rect.size())
+		reader.setScaledSize(aScaledSize);
+
+	QImage image = reader.read();
+	if (image.isNull()) {
+		qDebug() << "TiledImageSource::decode: " << reader.errorString();
+	}
+
+	return image;
+}
+
+//! \brief Returns true if the image of such size is too big to be loaded
+//! into memory as a whole
+/*!
+ * 16384x16384 pixels is 1 GB in 32 bit format, bigger images are decoded
+ * by tiles.
+ */
+bool
+TiledImageSource::isHuge(const QSize &aSize)
+{
+	return qint64(16384) * 16384 <
+		qint64(aSize.width()) * aSize.height();
+}
+
+/*
+ *
+ */
@@ -0,0 +1,70 @@
+/*!
+ * \file TiledImageSource.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: agent
+ */
+
+#ifndef __TILEDIMAGESOURCE_H__
+#define __TILEDIMAGESOURCE_H__
+
+#include <QString>
+#include <QByteArray>
+#include <QSize>
+#include <QRect>
+#include <QImage>
+
+//! \brief Image file which is decoded by regions on demand instead of
+//! being loaded into memory as a whole.
+/*!
+ * Only the header is read on construction. Every call of decode() opens
+ * its own QImageReader, so the object can be copied into worker threads
+ * and used there without any locking.
+ *
+ * Decoding regions makes sense only for the formats whose image handler
+ * supports QImageIOHandler::ClipRect(jpeg for instance), otherwise Qt
+ * decodes the whole image for every region.
+ *
+ * \see ImagePyramid::setSource(const TiledImageSource &aSource)
+ */
+class TiledImageSource
+{
+public:
+	TiledImageSource();
+	TiledImageSource(const QString &aPath);
+
+	bool isValid() const;
+	bool supportsRegions() const;
+	bool supportsScaling() const;
+	QString path() const;
+	QSize size() const;
+	QByteArray format() const;
+	QImage decode(
+		const QRect &aRect,
+		const QSize &aScaledSize
+		) const;
+
+	static bool isHuge(const QSize &aSize);
+
+private:
+	//! path to the image file
+	QString path_;
+
+	//! size of the image read from the header
+	QSize size_;
+
+	//! format of the image read from the header
+	QByteArray format_;
+
+	//! whether the image handler can decode a region without the whole image
+	bool supports_regions_;
+
+	//! whether the image handler can scale the image during decoding
+	bool supports_scaling_;
+};
+
+#endif /* __TILEDIMAGESOURCE_H__ */
+
+/*
+ *
+ */
@@ -6,14 +6,21 @@
  */
 
 #include "functions.h"
+#include "Figures.h"
 
 #include <QString>
+#include <QStringList>
+#include <QDir>
 #include <QChar>
 #include <QDomDocument>
 #include <QDomNode>
 #include <QDomText>
 #include <QPoint>
 #include <QLine>
+#include <QPolygonF>
+#include <QVector>
+#include <QPair>
+#include <QtAlgorithms>
 #include <qmath.h>
 #include <QDebug>
 
@@ -131,6 +138,43 @@ getPathFromFilename(const QString &aFilename)
 	return path;
 }
 
+//! Removes duplicates and directories lying inside other ones from the list
+/*!
+ *  example: /data, /data/cats, /mnt, /data -> /data, /mnt
+ *
+ *  Paths are compared after resolving symbolic links, the order of the
+ *  remaining directories is kept.
+ */
+QStringList
+removeNestedDirs(const QStringList &aDirs)
+{
+	QStringList canonical;
+	foreach (QString dir, aDirs) {
+		QString path = QDir(dir).canonicalPath();
+		if (!path.isEmpty() && !canonical.contains(path))
+			canonical.append(path);
+	}
+
+	QStringList result;
+	foreach (QString dir, canonical) {
+		bool nested = false;
+		foreach (QString other, canonical) {
+			QString prefix = other;
+			if (!prefix.endsWith('/'))
+				prefix.append('/');
+			if (other != dir && dir.startsWith(prefix)) {
+				nested = true;
+				break;
+			}
+		}
+
+		if (!nested)
+			result.append(dir);
+	}
+
+	return result;
+}
+
 //! Calculates coefficients a,b,c (ax + by + c = 0) for the straight line
 /*!
  * \see ImageHolder::posInPolygon(QPoint *aPos,QPolygon *aPoly)
@@ -189,6 +233,168 @@ pointToLineDistance(
 	return distance;
 }
 
+//! Removes the points of the polygon which deviate from its outline less than aTolerance
+/*!
+ * \param[in] aPoly polygon
+ * \param[in] aTolerance the largest distance between the outlines of the
+ * original and the simplified polygons
+ *
+ * Douglas-Peucker algorithm, the first and the last points are always kept.
+ */
+QPolygonF
+simplifyPolygon(
+	const QPolygonF &aPoly,
+	const double &aTolerance
+)
+{
+	int count = aPoly.count();
+	if (count < 4) {
+		return aPoly;
+		/* NOTREACHED */
+	}
+
+	QVector< bool > keep(count, false);
+	keep[0] = true;
+	keep[count - 1] = true;
+
+	double tolerance = aTolerance * aTolerance;
+	QVector< QPair< int, int > > ranges;
+	ranges.append(qMakePair(0, count - 1));
+
+	while (!ranges.isEmpty()) {
+		QPair< int, int > range = ranges.last();
+		ranges.pop_back();
+
+		QPointF first = aPoly.at(range.first);
+		double dx = aPoly.at(range.second).x() - first.x();
+		double dy = aPoly.at(range.second).y() - first.y();
+		double length = dx * dx + dy * dy;
+
+		/* looking for the point farthest from the line */
+		double maxDistance = 0;
+		int farthest = -1;
+		for (int i = range.first + 1; i < range.second; i++) {
+			double px = aPoly.at(i).x() - first.x();
+			double py = aPoly.at(i).y() - first.y();
+			double distance = px * px + py * py;
+			if (0 < length) {
+				double cross = px * dy - py * dx;
+				distance = cross * cross / length;
+			}
+
+			if (maxDistance < distance) {
+				maxDistance = distance;
+				farthest = i;
+			}
+		}
+
+		if (farthest < 0 || maxDistance <= tolerance)
+			continue;
+
+		keep[farthest] = true;
+		ranges.append(qMakePair(range.first, farthest));
+		ranges.append(qMakePair(farthest, range.second));
+	}
+
+	QPolygonF result;
+	for (int i = 0; i < count; i++) {
+		if (keep.at(i))
+			result.append(aPoly.at(i));
+	}
+
+	return result;
+}
+
+//! Fills one row of the segmented image with the labels of the objects
+/*!
+ * \param[in] aRow a number of the row
+ * \param[in] aFirst the first column to fill
+ * \param[in] aLast the last column to fill
+ * \param[in] aBoxes bounding boxes to check
+ * \param[in] aPolys polygons to check
+ * \param[in] aPolyRects bounding rects of aPolys, the polygons not
+ * crossing the row are skipped without walking their edges
+ * \param[out] aLabels an array of aLast - aFirst + 1 elements receiving
+ * label ids, 0 for the pixels out of any object
+ *
+ * Bboxes are drawn first, polygons next, so the later objects overlap
+ * the former ones. Polygons are filled between the pairs of their
+ * crossings with the row, following the scanline rule of
+ * QPolygon::containsPoint(Qt::OddEvenFill): horizontal edges are skipped,
+ * an edge covers the rows from its upper end to the lower one exclusive
+ * and a pixel is inside if an odd number of crossings are not right of it.
+ * The crossing is computed from the whole edge and truncated, Qt4 truncates
+ * the slope of the edge first, so pixels along slanted edges may differ
+ * from containsPoint(). The overlay and the saved picture are both
+ * rasterized here, so they always agree.
+ *
+ * \see ImageLabeler::labelRow()
+ * \see ImageHolder::rasterizeSegmentation(const QRect &aRect)
+ */
+void
+rasterizeRow(
+	int aRow,
+	int aFirst,
+	int aLast,
+	const QList< BoundingBox * > &aBoxes,
+	const QList< Polygon * > &aPolys,
+	const QVector< QRect > &aPolyRects,
+	int *aLabels
+)
+{
+	for (int j = aFirst; j <= aLast; j++)
+		aLabels[j - aFirst] = 0;
+
+	/* bboxes first */
+	for (int i = 0; i < aBoxes.count(); i++) {
+		BoundingBox *bbox = aBoxes.at(i);
+		QRect rect = bbox->rect.normalized();
+		if (aRow < rect.top() || rect.bottom() < aRow)
+			continue;
+
+		int right = qMin(rect.right(), aLast);
+		for (int j = qMax(rect.left(), aFirst); j <= right; j++)
+			aLabels[j - aFirst] = bbox->label_ID_;
+	}
+
+	/* polys next */
+	QVector< int > crossings;
+	for (int i = 0; i < aPolys.count(); i++) {
+		const QRect &rect = aPolyRects.at(i);
+		if (aRow < rect.top() || rect.bottom() < aRow)
+			continue;
+
+		const QPolygon &poly = aPolys.at(i)->poly;
+		int count = poly.count();
+		crossings.clear();
+		for (int j = 0; j < count; j++) {
+			QPoint p = poly.at(j);
+			QPoint q = poly.at((j + 1) % count);
+			if (p.y() == q.y())
+				continue;
+			if (q.y() < p.y())
+				qSwap(p, q);
+			if (aRow < p.y() || q.y() <= aRow)
+				continue;
+
+			crossings.append(
+				p.x() + int(qint64(q.x() - p.x()) * (aRow - p.y()) / (q.y() - p.y()))
+				);
+		}
+
+		if (crossings.count() < 2)
+			continue;
+
+		qSort(crossings);
+		for (int j = 0; j + 1 < crossings.count(); j += 2) {
+			int left = qMax(crossings.at(j), aFirst);
+			int right = qMin(crossings.at(j + 1) - 1, aLast);
+			for (int k = left; k <= right; k++)
+				aLabels[k - aFirst] = aPolys.at(i)->label_ID_;
+		}
+	}
+}
+
 /*
  *
  */
@@ -8,11 +8,19 @@
 #ifndef FUNCTIONS_H_
 #define FUNCTIONS_H_
 
+#include <QList>
+#include <QVector>
+
 class QString;
+class QStringList;
 class QChar;
 class QDomDocument;
 class QPoint;
 class QLine;
+class QPolygonF;
+class QRect;
+struct BoundingBox;
+struct Polygon;
 
 QString getDirFromPath(
 	const QString *aPath
@@ -36,6 +44,9 @@ QString removePath(
 QString getPathFromFilename(
 	const QString &aFilename
 	);
+QStringList removeNestedDirs(
+	const QStringList &aDirs
+	);
 void calcLineCoeff(
 	const QPoint &p1,
 	const QPoint &p2,
@@ -47,6 +58,19 @@ int pointToLineDistance(
 	const QLine &aLine,
 	const QPoint &aPoint
 	);
+QPolygonF simplifyPolygon(
+	const QPolygonF &aPoly,
+	const double &aTolerance
+	);
+void rasterizeRow(
+	int aRow,
+	int aFirst,
+	int aLast,
+	const QList< BoundingBox * > &aBoxes,
+	const QList< Polygon * > &aPolys,
+	const QVector< QRect > &aPolyRects,
+	int *aLabels
+	);
 
 #endif /* __FUNCTIONS_H__ */
 